@@ -0,0 +1,50 @@
+#include "allocationcounter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<bool> counting_enabled{false};
+std::atomic<size_t> allocation_count{0};
+std::atomic<size_t> allocated_bytes{0};
+
+}
+
+void SetAllocationCounting(bool enabled){
+	if(enabled){
+		allocation_count.store(0, std::memory_order_relaxed);
+		allocated_bytes.store(0, std::memory_order_relaxed);
+	}
+	counting_enabled.store(enabled, std::memory_order_release);
+}
+
+AllocationStats GetAllocationStats(){
+	return {allocation_count.load(std::memory_order_relaxed), allocated_bytes.load(std::memory_order_relaxed)};
+}
+
+//Замены стоят в отдельной единице трансляции и не встраиваются в места вызова:
+//иначе GCC видит пару new/free и выдает -Wmismatched-new-delete
+__attribute__((noinline)) void* operator new(size_t size){
+	if(counting_enabled.load(std::memory_order_relaxed)){
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+		allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+	if(void* result = std::malloc(size == 0 ? 1 : size)){
+		return result;
+	}
+	throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+#endif
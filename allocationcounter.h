@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+
+//Счетчик обращений к глобальному operator new для --bench allocations. Собирается только
+//с -DCOUNT_ALLOCATIONS: замена operator new/delete действует на всю программу и мешает
+//санитайзерам, поэтому в обычной сборке ее нет.
+//Подсчет по умолчанию выключен: тогда new стоит одно чтение флага, без атомарных изменений
+//общих счетчиков. Включенный считает выделения всех потоков
+#ifdef COUNT_ALLOCATIONS
+
+struct AllocationStats {
+	size_t count;
+	size_t bytes;
+};
+
+//Включение обнуляет счетчики
+void SetAllocationCounting(bool enabled);
+AllocationStats GetAllocationStats();
+
+#endif
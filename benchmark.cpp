@@ -0,0 +1,705 @@
+#include "benchmark.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "allocationcounter.h"
+#include "busmanager.h"
+#include "distance.h"
+#include "distancetable.h"
+#include "json.h"
+#include "jsonscanner.h"
+#include "nameindex.h"
+#include "responsewriter.h"
+#include "vertexorder.h"
+
+namespace {
+
+std::string ReadFile(const std::string& file_path){
+	std::ifstream input(file_path, std::ios::binary);
+	if(!input){
+		throw std::invalid_argument("file not found " + file_path);
+	}
+
+	std::stringstream ss;
+	ss << input.rdbuf();
+	return ss.str();
+}
+
+template <typename Func>
+double MeasureSeconds(Func func){
+	const auto start = std::chrono::steady_clock::now();
+	func();
+	const auto finish = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(finish - start).count();
+}
+
+double MegabytesPerSecond(size_t bytes, double seconds){
+	return bytes / seconds / (1024.0 * 1024.0);
+}
+
+//Поток, который только считает байты
+class CountingBuffer: public std::streambuf {
+public:
+	size_t GetCount() const {
+		return count;
+	}
+
+protected:
+	int_type overflow(int_type c) override {
+		count++;
+		return c;
+	}
+
+	std::streamsize xsputn(const char*, std::streamsize n) override {
+		count += n;
+		return n;
+	}
+
+private:
+	size_t count = 0;
+};
+
+//Все числовые литералы вне строк
+std::vector<std::string_view> ExtractNumbers(const std::string& text){
+	std::vector<std::string_view> result;
+	bool in_string = false;
+	for(size_t i = 0; i < text.size(); ){
+		const char c = text[i];
+		if(c == '"'){
+			in_string = !in_string;
+			i++;
+		} else if(!in_string && (isdigit(c) || c == '-' || c == '.')){
+			size_t j = i;
+			while(j < text.size() && (isdigit(text[j]) || strchr(".eE+-", text[j]) != nullptr)){
+				j++;
+			}
+			result.push_back(std::string_view(text).substr(i, j - i));
+			i = j;
+		} else {
+			i++;
+		}
+	}
+	return result;
+}
+
+double AsDouble(const Json::Node& node){
+	return node.IsDouble() ? node.AsDouble() : node.AsInt();
+}
+
+void BenchmarkNumbers(const std::string& file_path, std::ostream& out){
+	const std::string text = ReadFile(file_path);
+	const std::vector<std::string_view> numbers = ExtractNumbers(text);
+
+	size_t bytes = 0;
+	for(const auto number: numbers){
+		bytes += number.size();
+	}
+
+	const size_t repeat_count = 10;
+	double sum_parse = 0.0;
+	const double parse_seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			for(const auto number: numbers){
+				sum_parse += AsDouble(Json::ParseNumber(number));
+			}
+		}
+	});
+
+	double sum_strtod = 0.0;
+	const double strtod_seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			for(const auto number: numbers){
+				//за числом в тексте всегда идет разделитель, поэтому strtod остановится на его конце
+				sum_strtod += strtod(number.data(), nullptr);
+			}
+		}
+	});
+
+	size_t mismatch_count = 0;
+	for(const auto number: numbers){
+		const double parsed = AsDouble(Json::ParseNumber(number));
+		const double expected = strtod(number.data(), nullptr);
+		if(memcmp(&parsed, &expected, sizeof(double)) != 0){
+			if(mismatch_count++ < 10){
+				out << "mismatch: " << number << " parsed " << std::setprecision(17) << parsed
+						<< ", strtod " << expected << "\n";
+			}
+		}
+	}
+
+	out << "numbers - " << numbers.size() << "; bytes - " << bytes << "\n";
+	out << std::fixed << std::setprecision(1);
+	out << "Json::ParseNumber - " << MegabytesPerSecond(bytes * repeat_count, parse_seconds) << " MB/s, "
+			<< numbers.size() * repeat_count / parse_seconds / 1e6 << " M numbers/s\n";
+	out << "strtod - " << MegabytesPerSecond(bytes * repeat_count, strtod_seconds) << " MB/s, "
+			<< numbers.size() * repeat_count / strtod_seconds / 1e6 << " M numbers/s\n";
+	out << "mismatches against strtod - " << mismatch_count << "\n";
+	out << std::defaultfloat << "checksum - " << sum_parse - sum_strtod << "\n";
+}
+
+void BenchmarkJsonScan(const std::string& file_path, std::ostream& out){
+	const std::string text = ReadFile(file_path);
+	const size_t repeat_count = 10;
+
+	std::vector<uint32_t> index(text.size());
+	size_t index_size = 0;
+
+	auto scan = [&](auto scan_function){
+		return MeasureSeconds([&]{
+			for(size_t i = 0; i < repeat_count; i++){
+				Json::ScanState state;
+				index_size = scan_function(text.data(), text.size(), 0, state, index.data());
+			}
+		});
+	};
+
+	const double scalar_seconds = scan(Json::ScanStructuralsScalar);
+	const size_t scalar_count = index_size;
+	const double simd_seconds = scan(Json::ScanStructurals);
+
+	const double load_seconds = MeasureSeconds([&]{
+		std::istringstream input(text);
+		Json::Load(input);
+	});
+
+	out << "bytes - " << text.size() << "; structurals - " << index_size
+			<< (index_size == scalar_count ? "" : " (scalar scan differs!)") << "\n";
+	out << std::fixed << std::setprecision(2);
+	out << "structural scan - " << MegabytesPerSecond(text.size() * repeat_count, simd_seconds) / 1024.0 << " GB/s\n";
+	out << "structural scan (scalar) - " << MegabytesPerSecond(text.size() * repeat_count, scalar_seconds) / 1024.0 << " GB/s\n";
+	out << "Json::Load - " << MegabytesPerSecond(text.size(), load_seconds) << " MB/s\n";
+}
+
+//Ответы на запросы из файла в обоих форматах, плюс чистое форматирование
+//однотипных ответов в сравнении с operator<< в std::ostream
+void BenchmarkWriter(const std::string& file_path, std::ostream& out){
+	BusManager manager;
+	{
+		std::ifstream input(file_path, std::ios::binary);
+		manager.Read(input);
+	}
+
+	out << std::fixed << std::setprecision(1);
+	for(const auto format: {ResponseWriter::Format::Pretty, ResponseWriter::Format::Compact}){
+		CountingBuffer counter;
+		std::ostream null_stream(&counter);
+		manager.SetResponseFormat(format);
+		const double seconds = MeasureSeconds([&]{
+			manager.WriteResponse(null_stream);
+		});
+		out << (format == ResponseWriter::Format::Pretty ? "WriteResponse pretty - " : "WriteResponse compact - ")
+				<< counter.GetCount() << " bytes, " << MegabytesPerSecond(counter.GetCount(), seconds) << " MB/s\n";
+	}
+
+	const size_t response_count = 2'000'000;
+	{
+		CountingBuffer counter;
+		std::ostream null_stream(&counter);
+		const double seconds = MeasureSeconds([&]{
+			null_stream << "[\n";
+			for(size_t i = 0; i < response_count; i++){
+				null_stream << "\t{\n";
+				null_stream << "\t\t\"request_id\": " << i << ",\n";
+				null_stream << "\t\t\"route_length\": " << i * 7 << ",\n";
+				null_stream << "\t\t\"curvature\": " << 1.0 + i * 1e-7 << "\n";
+				null_stream << "\t},\n";
+			}
+			null_stream << "]";
+		});
+		out << "std::ostream synthetic - " << MegabytesPerSecond(counter.GetCount(), seconds) << " MB/s\n";
+	}
+
+	for(const auto format: {ResponseWriter::Format::Pretty, ResponseWriter::Format::Compact}){
+		CountingBuffer counter;
+		std::ostream null_stream(&counter);
+		const double seconds = MeasureSeconds([&]{
+			ResponseWriter writer(null_stream, format);
+			writer.BeginArray();
+			for(size_t i = 0; i < response_count; i++){
+				writer.BeginObject()
+					.Key("request_id").Value(i)
+					.Key("route_length").Value(i * 7)
+					.Key("curvature").Value(1.0 + i * 1e-7)
+					.EndObject();
+			}
+			writer.EndArray();
+		});
+		out << (format == ResponseWriter::Format::Pretty ? "ResponseWriter synthetic pretty - " : "ResponseWriter synthetic compact - ")
+				<< MegabytesPerSecond(counter.GetCount(), seconds) << " MB/s\n";
+	}
+}
+
+#ifdef COUNT_ALLOCATIONS
+//Число выделений памяти и время BusManager::Read; пересчитывается и маршрутизатор
+void BenchmarkAllocations(const std::string& file_path, std::ostream& out){
+	const std::string json_text = ReadFile(file_path);
+	const size_t repeat_count = 5;
+
+	AllocationStats read_stats{0, 0};
+	const double seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			std::istringstream input(json_text);
+			BusManager manager;
+			SetAllocationCounting(true);
+			manager.Read(input);
+			read_stats = GetAllocationStats();
+			SetAllocationCounting(false);
+		}
+	});
+
+	out << "Read - " << read_stats.count << " allocations, " << read_stats.bytes / 1024 << " KiB requested\n";
+
+	//Ответы: первый проход прогревает буферы, второй показывает установившийся режим
+	std::istringstream input(json_text);
+	BusManager manager;
+	manager.Read(input);
+	CountingBuffer counter;
+	std::ostream null_stream(&counter);
+	manager.WriteResponse(null_stream);
+	SetAllocationCounting(true);
+	manager.WriteResponse(null_stream);
+	const AllocationStats response_stats = GetAllocationStats();
+	SetAllocationCounting(false);
+	out << "WriteResponse - " << response_stats.count << " allocations\n";
+
+	out << std::fixed << std::setprecision(3);
+	out << "Read with destruction - " << seconds / repeat_count * 1e3 << " ms\n";
+}
+#else
+void BenchmarkAllocations(const std::string&, std::ostream& out){
+	out << "Allocation counting is not built in: rebuild with -DCOUNT_ALLOCATIONS\n";
+}
+#endif
+
+//Нумерации вершин: время Read (с построением маршрутизатора) и ответов на stat_requests.
+//Ответы могут отличаться только выбором среди равных по времени маршрутов
+void BenchmarkVertexOrder(const std::string& file_path, std::ostream& out){
+	const std::string json_text = ReadFile(file_path);
+
+	out << std::fixed << std::setprecision(3);
+	for(const VertexOrder order: {VertexOrder::Bus, VertexOrder::Bfs, VertexOrder::Rcm, VertexOrder::Hilbert}){
+		BusManager manager;
+		manager.SetVertexOrder(order).SetResponseFormat(ResponseWriter::Format::Compact);
+		const double read_seconds = MeasureSeconds([&]{
+			std::istringstream input(json_text);
+			manager.Read(input);
+		});
+
+		CountingBuffer buffer;
+		std::ostream output(&buffer);
+		const double response_seconds = MeasureSeconds([&]{
+			manager.WriteResponse(output);
+		});
+
+		out << GetVertexOrderName(order) << " - Read " << read_seconds << " s, responses " << response_seconds
+				<< " s, " << buffer.GetCount() << " bytes\n";
+	}
+}
+
+//Загрузка сети из JSON против загрузки из двоичного снимка; в обоих случаях строится маршрутизатор.
+//После LoadSnapshot он достраивается в фоне: отдельно время до возврата и до готовности всех таблиц
+void BenchmarkSnapshot(const std::string& file_path, std::ostream& out){
+	const std::string json_text = ReadFile(file_path);
+
+	std::stringstream snapshot;
+	const double json_seconds = MeasureSeconds([&]{
+		std::istringstream input(json_text);
+		BusManager manager;
+		manager.Read(input);
+		manager.SaveSnapshot(snapshot);
+	});
+	const size_t snapshot_size = snapshot.str().size();
+
+	double load_seconds = 0.0;
+	const double snapshot_seconds = MeasureSeconds([&]{
+		BusManager manager;
+		load_seconds = MeasureSeconds([&]{
+			manager.LoadSnapshot(snapshot);
+		});
+	});
+
+	out << std::fixed << std::setprecision(3);
+	out << "JSON " << json_text.size() << " bytes, Read - " << json_seconds << " s\n";
+	out << "Snapshot " << snapshot_size << " bytes, LoadSnapshot - " << load_seconds << " s, with routers - "
+			<< snapshot_seconds << " s\n";
+}
+
+//Ключ пары остановок для сравнения DistanceTable с unordered_map
+struct StopIdPair {
+	uint32_t stop_from;
+	uint32_t stop_to;
+
+	bool operator == (const StopIdPair& other) const {
+		return stop_from == other.stop_from && stop_to == other.stop_to;
+	}
+};
+
+struct StopIdPairHasher {
+	size_t operator() (const StopIdPair& sp) const {
+		return shash((static_cast<uint64_t>(sp.stop_from) << 32) | sp.stop_to);
+	}
+
+	std::hash<uint64_t> shash;
+};
+
+//Пары расстояний из base_requests: имена остановок переводятся в id в порядке появления
+std::vector<std::pair<StopIdPair, uint64_t>> ExtractDistances(const std::string& file_path){
+	std::ifstream input(file_path, std::ios::binary);
+	const Json::Document document = Json::Load(input);
+
+	std::unordered_map<std::string_view, uint32_t> stop_ids;
+	auto intern = [&stop_ids](std::string_view name){
+		return stop_ids.emplace(name, stop_ids.size()).first->second;
+	};
+
+	std::vector<std::pair<StopIdPair, uint64_t>> result;
+	const Json::Map root = document.GetRoot().AsMap();
+	if(const auto it = root.find("base_requests"); it != root.end()){
+		for(const auto& request: it->second.AsArray()){
+			const Json::Map request_map = request.AsMap();
+			const auto it_name = request_map.find("name");
+			const auto it_distances = request_map.find("road_distances");
+			if(it_name == request_map.end() || it_distances == request_map.end()){
+				continue;
+			}
+
+			const uint32_t stop_from = intern(it_name->second.AsString());
+			for(const auto& [stop_name, distance]: it_distances->second.AsMap()){
+				result.push_back({{stop_from, intern(stop_name)}, static_cast<uint64_t>(distance.AsInt())});
+			}
+		}
+	}
+	return result;
+}
+
+//Маршруты из base_requests как последовательности координат остановок
+std::vector<std::vector<Point>> ExtractBusPaths(const std::string& file_path){
+	std::ifstream input(file_path, std::ios::binary);
+	const Json::Document document = Json::Load(input);
+
+	std::unordered_map<std::string, Point> stop_points;
+	std::vector<std::vector<std::string>> bus_stops;
+	const Json::Map root = document.GetRoot().AsMap();
+	if(const auto it = root.find("base_requests"); it != root.end()){
+		for(const auto& request: it->second.AsArray()){
+			const Json::Map request_map = request.AsMap();
+			std::string_view type;
+			std::string name;
+			Point point = {0.0, 0.0};
+			std::vector<std::string> names;
+			for(const auto& [key, value]: request_map){
+				if(key == "type"){
+					type = value.AsString();
+				} else if(key == "name"){
+					name = value.AsString();
+				} else if(key == "latitude"){
+					point.latitude = AsDouble(value);
+				} else if(key == "longitude"){
+					point.longitude = AsDouble(value);
+				} else if(key == "stops"){
+					for(const auto& stop: value.AsArray()){
+						names.emplace_back(stop.AsString());
+					}
+				}
+			}
+
+			if(type == "Stop"){
+				stop_points[name] = point;
+			} else if(type == "Bus"){
+				bus_stops.push_back(std::move(names));
+			}
+		}
+	}
+
+	std::vector<std::vector<Point>> result;
+	for(const auto& names: bus_stops){
+		std::vector<Point> path;
+		for(const auto& name: names){
+			if(const auto it = stop_points.find(name); it != stop_points.end()){
+				path.push_back(it->second);
+			}
+		}
+		if(path.size() >= 2){
+			result.push_back(std::move(path));
+		}
+	}
+	return result;
+}
+
+//Длина маршрута по прямой: Distance на каждый отрезок против точек с готовыми sin/cos,
+//скалярно и пакетно. Плюс наибольшее отклонение пакетного варианта от Distance
+void BenchmarkGeo(const std::string& file_path, std::ostream& out){
+	const auto paths = ExtractBusPaths(file_path);
+	if(paths.empty()){
+		out << "no buses with known stops in " << file_path << "\n";
+		return;
+	}
+
+	std::vector<std::vector<GeoPoint>> geo_paths;
+	size_t segment_count = 0;
+	for(const auto& path: paths){
+		geo_paths.emplace_back(path.begin(), path.end());
+		segment_count += path.size() - 1;
+	}
+	const size_t repeat_count = std::max<size_t>(1, 20'000'000 / segment_count);
+
+	double distance_sum = 0.0;
+	const double distance_seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			for(const auto& path: paths){
+				for(size_t j = 0; j + 1 < path.size(); j++){
+					distance_sum += Distance(path[j], path[j + 1]).Length();
+				}
+			}
+		}
+	});
+
+	double scalar_sum = 0.0;
+	const double scalar_seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			for(const auto& path: geo_paths){
+				scalar_sum += GeoPathLengthScalar(path.data(), path.size());
+			}
+		}
+	});
+
+	double batch_sum = 0.0;
+	const double batch_seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			for(const auto& path: geo_paths){
+				batch_sum += GeoPathLength(path.data(), path.size());
+			}
+		}
+	});
+
+	//Каждый отрезок прогоняется через пакетный путь четырежды: a-b-a-b-a
+	double max_absolute = 0.0;
+	double max_relative = 0.0;
+	for(const auto& path: paths){
+		for(size_t j = 0; j + 1 < path.size(); j++){
+			const GeoPoint a(path[j]);
+			const GeoPoint b(path[j + 1]);
+			const GeoPoint points[] = {a, b, a, b, a};
+			const double expected = Distance(path[j], path[j + 1]).Length();
+			const double deviation = std::abs(GeoPathLength(points, 5) / 4 - expected);
+			max_absolute = std::max(max_absolute, deviation);
+			if(expected > 0){
+				max_relative = std::max(max_relative, deviation / expected);
+			}
+		}
+	}
+
+	const double segments = static_cast<double>(segment_count) * repeat_count;
+	out << "segments - " << segments << "\n";
+	out << std::fixed << std::setprecision(1);
+	out << "Distance - " << segments / distance_seconds / 1e6 << " M segments/s\n";
+	out << "GeoPathLengthScalar - " << segments / scalar_seconds / 1e6 << " M segments/s\n";
+	out << "GeoPathLength - " << segments / batch_seconds / 1e6 << " M segments/s\n";
+	out << std::scientific << std::setprecision(2);
+	out << "max deviation from Distance - " << max_absolute << " m, " << max_relative << " relative; "
+			<< "total - " << std::abs(batch_sum - distance_sum) / distance_sum << " relative\n";
+}
+
+//Имена остановок и маршрутов из base_requests, без повторов
+std::vector<std::string> ExtractNames(const std::string& file_path){
+	std::ifstream input(file_path, std::ios::binary);
+	const Json::Document document = Json::Load(input);
+
+	std::unordered_set<std::string> names;
+	const Json::Map root = document.GetRoot().AsMap();
+	if(const auto it = root.find("base_requests"); it != root.end()){
+		for(const auto& request: it->second.AsArray()){
+			for(const auto& [key, value]: request.AsMap()){
+				if(key == "name"){
+					names.emplace(value.AsString());
+				} else if(key == "stops" || key == "road_distances"){
+					if(value.IsArray()){
+						for(const auto& stop: value.AsArray()){
+							names.emplace(stop.AsString());
+						}
+					} else {
+						for(const auto& [stop_name, _]: value.AsMap()){
+							names.emplace(stop_name);
+						}
+					}
+				}
+			}
+		}
+	}
+	return {names.begin(), names.end()};
+}
+
+//Поиск id по имени: unordered_map против совершенного хеша NameIndex.
+//Запросы - std::string, как в командах; половина промахов в отдельном замере
+void BenchmarkNames(const std::string& file_path, std::ostream& out){
+	const std::vector<std::string> names = ExtractNames(file_path);
+	if(names.empty()){
+		out << "no names in " << file_path << "\n";
+		return;
+	}
+
+	std::unordered_map<std::string, uint32_t> map;
+	NameIndex index;
+	const double map_build_seconds = MeasureSeconds([&]{
+		for(uint32_t i = 0; i < names.size(); i++){
+			map.emplace(names[i], i);
+		}
+	});
+	const double index_build_seconds = MeasureSeconds([&]{
+		index.Build({names.begin(), names.end()});
+	});
+
+	std::vector<std::string> hits = names;
+	std::shuffle(hits.begin(), hits.end(), std::mt19937(42));
+	std::vector<std::string> mixed;
+	for(const std::string& name: hits){
+		mixed.push_back(name);
+		mixed.push_back(name + "~");
+	}
+	const size_t repeat_count = std::max<size_t>(1, 20'000'000 / hits.size());
+
+	auto measure = [&](const std::vector<std::string>& queries, auto find){
+		uint64_t checksum = 0;
+		const double seconds = MeasureSeconds([&]{
+			for(size_t i = 0; i < repeat_count; i++){
+				for(const std::string& query: queries){
+					checksum += find(query);
+				}
+			}
+		});
+		return std::pair{static_cast<double>(queries.size()) * repeat_count / seconds, checksum};
+	};
+	auto map_find = [&map](const std::string& name) -> uint64_t {
+		const auto it = map.find(name);
+		return it == map.end() ? 0 : it->second + 1;
+	};
+	auto index_find = [&index](const std::string& name) -> uint64_t {
+		const auto id = index.Find(name);
+		return id ? *id + 1 : 0;
+	};
+
+	const auto [map_hits, map_hits_sum] = measure(hits, map_find);
+	const auto [index_hits, index_hits_sum] = measure(hits, index_find);
+	const auto [map_mixed, map_mixed_sum] = measure(mixed, map_find);
+	const auto [index_mixed, index_mixed_sum] = measure(mixed, index_find);
+
+	const size_t map_bytes = map.size() * (2 * sizeof(void*) + sizeof(std::pair<const std::string, uint32_t>))
+			+ map.bucket_count() * sizeof(void*);
+
+	out << "names - " << names.size()
+			<< (map_hits_sum == index_hits_sum && map_mixed_sum == index_mixed_sum ? "" : " (results differ!)") << "\n";
+	out << std::fixed << std::setprecision(1);
+	out << "unordered_map - " << map_hits / 1e6 << " M lookups/s, with misses " << map_mixed / 1e6
+			<< " M lookups/s, build " << map_build_seconds * 1e3 << " ms, ~" << map_bytes / 1024.0 << " KiB\n";
+	out << "NameIndex - " << index_hits / 1e6 << " M lookups/s, with misses " << index_mixed / 1e6
+			<< " M lookups/s, build " << index_build_seconds * 1e3 << " ms, " << index.MemoryUsage() / 1024.0 << " KiB\n";
+}
+
+//Поиск расстояния по отрезку: прежняя хеш-таблица на узлах с поиском в обе стороны
+//против плоской таблицы с достроенными обратными направлениями
+void BenchmarkDistances(const std::string& file_path, std::ostream& out){
+	const auto distances = ExtractDistances(file_path);
+	if(distances.empty()){
+		out << "no road_distances in " << file_path << "\n";
+		return;
+	}
+
+	std::unordered_map<StopIdPair, size_t, StopIdPairHasher> map;
+	DistanceTable table;
+	const double map_build_seconds = MeasureSeconds([&]{
+		for(const auto& [stop_pair, distance]: distances){
+			map.emplace(stop_pair, distance);
+		}
+	});
+	const double table_build_seconds = MeasureSeconds([&]{
+		for(const auto& [stop_pair, distance]: distances){
+			table.Insert(stop_pair.stop_from, stop_pair.stop_to, distance);
+		}
+		table.AddReverseDirections();
+	});
+
+	//Отрезки в обоих направлениях в случайном порядке
+	std::vector<StopIdPair> queries;
+	for(const auto& [stop_pair, _]: distances){
+		queries.push_back(stop_pair);
+		queries.push_back({stop_pair.stop_to, stop_pair.stop_from});
+	}
+	std::shuffle(queries.begin(), queries.end(), std::mt19937(42));
+	const size_t repeat_count = std::max<size_t>(1, 20'000'000 / queries.size());
+
+	uint64_t map_sum = 0;
+	const double map_seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			for(const StopIdPair& query: queries){
+				auto it = map.find(query);
+				if(it == map.end()){
+					it = map.find({query.stop_to, query.stop_from});
+				}
+				map_sum += it->second;
+			}
+		}
+	});
+
+	uint64_t table_sum = 0;
+	const double table_seconds = MeasureSeconds([&]{
+		for(size_t i = 0; i < repeat_count; i++){
+			for(const StopIdPair& query: queries){
+				table_sum += *table.Find(query.stop_from, query.stop_to);
+			}
+		}
+	});
+
+	//Узел: указатель на следующий и пара ключ-значение; служебные байты аллокатора не учтены
+	const size_t map_bytes = map.size() * (sizeof(void*) + sizeof(std::pair<const StopIdPair, size_t>))
+			+ map.bucket_count() * sizeof(void*);
+	const double lookup_count = static_cast<double>(queries.size()) * repeat_count;
+
+	out << "pairs - " << distances.size() << "; lookups - " << lookup_count
+			<< (map_sum == table_sum ? "" : " (sums differ!)") << "\n";
+	out << std::fixed << std::setprecision(1);
+	out << "unordered_map - " << lookup_count / map_seconds / 1e6 << " M lookups/s, build "
+			<< map_build_seconds * 1e3 << " ms, ~" << map_bytes / 1024.0 << " KiB\n";
+	out << "DistanceTable - " << lookup_count / table_seconds / 1e6 << " M lookups/s, build "
+			<< table_build_seconds * 1e3 << " ms, " << table.MemoryUsage() / 1024.0 << " KiB ("
+			<< table.Size() << " of " << table.Capacity() << " slots, with reverse directions)\n";
+}
+
+}
+
+int RunBenchmark(const std::string& name, const std::string& file_path, std::ostream& out){
+	static const std::map<std::string, std::function<void(const std::string&, std::ostream&)>> benchmarks = {
+		{"allocations", BenchmarkAllocations},
+		{"distances", BenchmarkDistances},
+		{"geo", BenchmarkGeo},
+		{"json-scan", BenchmarkJsonScan},
+		{"names", BenchmarkNames},
+		{"numbers", BenchmarkNumbers},
+		{"snapshot", BenchmarkSnapshot},
+		{"vertex-order", BenchmarkVertexOrder},
+		{"writer", BenchmarkWriter},
+	};
+
+	const auto it = benchmarks.find(name);
+	if(it == benchmarks.end()){
+		out << "Unknown benchmark " << name << ". Available:";
+		for(const auto& [benchmark_name, _]: benchmarks){
+			out << " " << benchmark_name;
+		}
+		out << '\n';
+		return 1;
+	}
+
+	it->second(file_path, out);
+	return 0;
+}
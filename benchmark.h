@@ -0,0 +1,6 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+//Замеры производительности: запуск - program --bench <name> <file>
+int RunBenchmark(const std::string& name, const std::string& file_path, std::ostream& out = std::cout);
@@ -1,21 +1,24 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <string_view>
 #include "stop.h"
 
 struct Bus {
-	struct Stop{
-		size_t stop_id;
-		std::string stop_name;
-	};
-
 	std::string name;
 	size_t unique_stops_count;
-	std::vector<Stop> stops;
+	std::vector<uint32_t> stops; //id остановок в порядке следования
 	RouteType route_type;
 
 	const size_t GetSize() const;
 };
 
-
+//Ответ на запрос Bus: считается один раз после загрузки
+struct BusStats {
+	size_t stop_count;
+	size_t unique_stop_count;
+	size_t route_length; //По дорогам, в метрах
+	double geo_length; //По прямой, в метрах
+	double curvature;
+};
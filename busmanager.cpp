@@ -2,16 +2,25 @@
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
+#include <cassert>
 #include <iomanip>
 #include <iterator>
+#include <numeric>
 #include <unordered_set>
 #include <utility>
-#include <unordered_set>
+#include "parallel.h"
+#include "snapshot.h"
 #include "stringhelper.h"
 
-BusManager::BusManager(): last_init_id(0){}
+BusManager::BusManager(): last_init_id(0), stop_ids(&name_pool), bus_ids(&name_pool){}
+
+BusManager::~BusManager(){
+	if(router_builder.joinable()){
+		router_builder.join();
+	}
+}
 
-BusManager& BusManager::ReadSettings(const std::map<std::string, Json::Node>& node) {
+BusManager& BusManager::ReadSettings(const Json::Map& node) {
 
 	for(const auto& [node_name, value]: node) {
 		if(node_name == "bus_wait_time"){
@@ -20,488 +29,998 @@ BusManager& BusManager::ReadSettings(const std::map<std::string, Json::Node>& no
 			//В метрах/минуту
 			settings.bus_velocity = ((value.IsDouble()) ? value.AsDouble() : value.AsInt()) * 1000.0 / 60.0;
  		} else {
- 			throw std::invalid_argument("BusManager::ReadSettings unsupported argument name " + node_name);
+ 			throw std::invalid_argument("BusManager::ReadSettings unsupported argument name " + std::string(node_name));
  		}
 	}
 	return *this;
 }
 
-BusManager& BusManager::ReadData(const std::vector<Json::Node>& node){
-	std::vector<std::string> data_types;
-	for(const auto& node_array: node){
-		const auto& node_map = node_array.AsMap();
-		for(const auto& [node_name, value]: node_map) {
-			if(node_name == "type"){
-				data_types.push_back(value.AsString());
-				break;
-			}
-		}
+BusManager& BusManager::ReadData(const Json::Map& node_map){
+	const auto it_type = node_map.find("type");
+	if(it_type == node_map.end()){
+		throw std::invalid_argument("BusManager::ReadData: type not found");
 	}
 
-	auto it_data_types = data_types.begin();
-	for(const auto& node_array: node){
-		const auto& node_map = node_array.AsMap();
-
-		if(*it_data_types == "Stop"){
-			Stop stop;
-			stop.id = stops.size();
-
-			std::unordered_map<std::string, size_t> other_stops;
+	const std::string_view data_type = it_type->second.AsString();
+	if(data_type == "Stop"){
+		std::string_view stop_name;
+		Point point;
+		//Расстояния читаются прямо из узла после регистрации остановки, без промежуточной копии
+		Json::Map other_stops;
 
-			for(const auto& [node_name, value]: node_map) {
-				//std::string node_name = item_map.first;
-				if(node_name == "name"){
-					stop.name = value.AsString();
-				} else if(node_name == "latitude"){
-					stop.point.latitude = value.IsDouble() ? value.AsDouble() : value.AsInt();
-				} else if(node_name == "longitude"){
-					stop.point.longitude = value.IsDouble() ? value.AsDouble() : value.AsInt();
-				} else if(node_name == "road_distances"){
-					const std::map<std::string, Json::Node>& item_stops = value.AsMap();
-					for(const auto& [stop_name, stop_distance]: item_stops){
-						other_stops.emplace( std::make_pair(stop_name, stop_distance.AsInt()) );
-					}
-				} else if(node_name == "type"){
-					continue; //
-				} else {
-					throw std::invalid_argument("BusManager::ReadData: Stop unsupported argument name " + node_name);
-				}
+		for(const auto& [node_name, value]: node_map) {
+			if(node_name == "name"){
+				stop_name = value.AsString();
+			} else if(node_name == "latitude"){
+				point.latitude = value.IsDouble() ? value.AsDouble() : value.AsInt();
+			} else if(node_name == "longitude"){
+				point.longitude = value.IsDouble() ? value.AsDouble() : value.AsInt();
+			} else if(node_name == "road_distances"){
+				other_stops = value.AsMap();
+			} else if(node_name == "type"){
+				continue; //
+			} else {
+				throw std::invalid_argument("BusManager::ReadData: Stop unsupported argument name " + std::string(node_name));
 			}
+		}
 
-			for(const auto& [other_stop_name, other_stop_distance]: other_stops){
-				stop_distances.emplace(std::make_pair(StopPair{stop.name, other_stop_name}, other_stop_distance));
-			}
+		const uint32_t stop_id = InternStop(stop_name);
+		if(!stops[stop_id].declared){
+			stops[stop_id].point = point;
+			stops[stop_id].geo = GeoPoint(point);
+			stops[stop_id].declared = true;
+		}
 
-			stops.emplace(std::pair<std::string, Stop>{stop.name, stop});
-		} else if(*it_data_types == "Bus"){
-			Bus bus;
-			for(const auto& [node_name, value]: node_map) {
-				if(node_name == "name"){
-					bus.name = value.AsString();
-				} else if(node_name == "is_roundtrip"){
-					bus.route_type = value.AsBool() ? RouteType::Round : RouteType::Line;
-				} else if(node_name == "stops"){
-					const std::vector<Json::Node>& item_stops = value.AsArray();
-					std::unordered_set<std::string> unique_stops;
-
-					size_t bus_stop_id = 0;
-					for(const auto& item_stop: item_stops){
-						bus.stops.push_back({bus_stop_id++, item_stop.AsString()});
-						unique_stops.insert(item_stop.AsString());
-					}
-					bus.unique_stops_count = unique_stops.size();
-				} else if(node_name == "type"){
-					continue;
-				} else {
-					throw std::invalid_argument("BusManager::ReadData: Bus unsupported argument name " + node_name);
+		for(const auto& [other_stop_name, other_stop_distance]: other_stops){
+			stop_distances.Insert(stop_id, InternStop(other_stop_name), other_stop_distance.AsInt());
+		}
+	} else if(data_type == "Bus"){
+		Bus bus;
+		for(const auto& [node_name, value]: node_map) {
+			if(node_name == "name"){
+				bus.name = value.AsString();
+			} else if(node_name == "is_roundtrip"){
+				bus.route_type = value.AsBool() ? RouteType::Round : RouteType::Line;
+			} else if(node_name == "stops"){
+				bus.stops.reserve(value.AsArray().size());
+				for(const auto& item_stop: value.AsArray()){
+					bus.stops.push_back(InternStop(item_stop.AsString()));
 				}
-			}
 
-			buses.emplace(std::pair<std::string, Bus>{bus.name, bus});
-			for(const auto& stop: bus.stops){
-				stop_to_buses[stop.stop_name].insert(bus.name);
+				//Временная копия живет только здесь: берем ее из буфера на стеке, в кучу - только длинные маршруты
+				std::byte scratch_buffer[SCRATCH_BUFFER_SIZE];
+				std::pmr::monotonic_buffer_resource scratch(scratch_buffer, sizeof(scratch_buffer));
+				std::pmr::vector<uint32_t> unique_stops(bus.stops.begin(), bus.stops.end(), &scratch);
+				std::sort(unique_stops.begin(), unique_stops.end());
+				bus.unique_stops_count = std::unique(unique_stops.begin(), unique_stops.end()) - unique_stops.begin();
+			} else if(node_name == "type"){
+				continue;
+			} else {
+				throw std::invalid_argument("BusManager::ReadData: Bus unsupported argument name " + std::string(node_name));
 			}
-		} else {
-			throw std::invalid_argument("BusManager::ReadData: unsupported data type " + *it_data_types);
 		}
 
-		it_data_types++;
+		if(bus_ids.emplace(bus.name, buses.size()).second){
+			buses.push_back(std::move(bus));
+		}
+	} else {
+		throw std::invalid_argument("BusManager::ReadData: unsupported data type " + std::string(data_type));
 	}
 
 	return *this;
 }
 
-BusManager& BusManager::ReadRequest(const std::vector<Json::Node>& node){
-	for(const auto& node_array: node){
-		const auto& node_map = node_array.AsMap();
-		std::unique_ptr<Command> command;
+//Остановка могла встретиться в маршруте или в road_distances раньше своего описания
+uint32_t BusManager::InternStop(std::string_view name){
+	const auto [it, inserted] = stop_ids.emplace(std::string(name), stops.size());
+	if(inserted){
+		stops.push_back({it->second, it->first, {0.0, 0.0}, false, GeoPoint({0.0, 0.0})});
+	}
+	return it->second;
+}
 
-		for(const auto& [node_name, value]: node_map) {
-			if(node_name == "type"){
-				const std::string type = value.AsString();
-				if(type == "Bus"){
-					command = std::make_unique<BusCommand>();
-				} else if(type == "Stop"){
-					command = std::make_unique<StopCommand>();
-				} else if(type == "Route"){
-					command = std::make_unique<RouteCommand>();
-				}else {
-					throw std::invalid_argument("BusManager::ReadRequest: unsupported command type " + type);
-				}
+std::unique_ptr<Command> BusManager::ReadRequest(const Json::Map& node_map) const {
+	const auto it_type = node_map.find("type");
+	if(it_type == node_map.end()){
+		throw std::invalid_argument("BusManager::ReadRequest: type not found");
+	}
 
-				commands.push_back(move(command));
-				break;
-			}
-		}
+	std::unique_ptr<Command> command;
+	const std::string_view type = it_type->second.AsString();
+	if(type == "Bus"){
+		command = std::make_unique<BusCommand>();
+	} else if(type == "Stop"){
+		command = std::make_unique<StopCommand>();
+	} else if(type == "Route"){
+		command = std::make_unique<RouteCommand>();
+	}else {
+		throw std::invalid_argument("BusManager::ReadRequest: unsupported command type " + std::string(type));
 	}
 
-	auto it_command_types = commands.begin();
-	for(const auto& node_array: node){
-		const auto& node_map = node_array.AsMap();
+	for(const auto& [node_name, value]: node_map) {
+		if(node_name == "id"){
+			command->id = value.AsInt();
+			continue;
+		} else if(node_name == "type"){
+			continue;
+		}
 
-		for(const auto& [node_name, value]: node_map) {
-			if(node_name == "id"){
-				(*it_command_types)->id = value.AsInt();
-				continue;
-			} else if(node_name == "type"){
-				continue;
+		if(command->GetType() == CommandType::Bus){
+			if(node_name == "name"){
+				static_cast<BusCommand&>(*command).name = value.AsString();
 			}
-
-			if((*it_command_types)->GetType() == CommandType::Bus){
-				if(node_name == "name"){
-					((BusCommand*)(it_command_types->get()))->name = value.AsString();
-				}
-			} else if((*it_command_types)->GetType() == CommandType::Stop){
-				if(node_name == "name"){
-					((StopCommand*)(it_command_types->get()))->name = value.AsString();
-				}
-			} else if((*it_command_types)->GetType() == CommandType::Route){
-				if(node_name == "from"){
-					((RouteCommand*)(it_command_types->get()))->stop_from = value.AsString();
-				} else if(node_name == "to") {
-					((RouteCommand*)(it_command_types->get()))->stop_to = value.AsString();
-				} else {
-					throw std::invalid_argument("BusManager::ReadRequest: RouteCommand unsupported key: " + node_name);
-				}
+		} else if(command->GetType() == CommandType::Stop){
+			if(node_name == "name"){
+				static_cast<StopCommand&>(*command).name = value.AsString();
+			}
+		} else if(command->GetType() == CommandType::Route){
+			if(node_name == "from"){
+				static_cast<RouteCommand&>(*command).stop_from = value.AsString();
+			} else if(node_name == "to") {
+				static_cast<RouteCommand&>(*command).stop_to = value.AsString();
 			} else {
-				throw std::invalid_argument("BusManager::ReadRequest: unsupported command type");
+				throw std::invalid_argument("BusManager::ReadRequest: RouteCommand unsupported key: " + std::string(node_name));
 			}
 		}
-
-		it_command_types++;
 	}
 
-	return *this;
+	return command;
 }
 
 BusManager& BusManager::Read(std::istream& in){
-	Json::Document doc = Json::Load(in);
-	const Json::Node& node_root = doc.GetRoot();
-	const auto& root_map = node_root.AsMap();
+	ReadDocument(in, nullptr);
+	return *this;
+}
+
+BusManager& BusManager::ReadNetwork(std::istream& in){
+	ReadDocument(in, nullptr, false);
+	return *this;
+}
+
+void BusManager::Process(std::istream& in, std::ostream& out){
+	ResponseWriter writer(out, response_format);
+	writer.BeginArray();
+
+	ReadDocument(in, &writer);
+
+	//stat_requests шли в документе раньше данных
+	for(const auto& command: commands){
+		WriteResponse(*command, writer);
+	}
+	commands.clear();
 
-	for(const auto& [node_name, value]: root_map){
-		//const std::string node_name = node.first;
+	writer.EndArray();
+}
+
+void BusManager::ReadDocument(std::istream& in, ResponseWriter* writer, bool build_router){
+	//Документ целиком не строим: каждый запрос разбирается и сразу переносится в данные
+	bool base_loaded = false;
+	bool settings_loaded = false;
+
+	Json::Reader reader(in);
+	reader.ReadMap([&](const std::string& node_name){
 		if(node_name == "base_requests"){
-			ReadData(value.AsArray());
+			reader.ReadArray([&]{
+				ReadData(reader.ReadNode().AsMap());
+			});
+			base_loaded = true;
+			json_arena_size = reader.GetArenaPeakSize();
+			ReportMemory("base");
 		} else if(node_name == "stat_requests"){
-			ReadRequest(value.AsArray());
+			if(writer != nullptr && (routes_built || (base_loaded && settings_loaded))){
+				//Данные уже есть: отвечаем на каждый запрос сразу после разбора
+				BuildRoutes();
+				reader.ReadArray([&]{
+					WriteResponse(*ReadRequest(reader.ReadNode().AsMap()), *writer);
+				});
+			} else {
+				reader.ReadArray([&]{
+					commands.push_back(ReadRequest(reader.ReadNode().AsMap()));
+				});
+			}
 		} else if(node_name == "routing_settings"){
-			ReadSettings(value.AsMap());
+			ReadSettings(reader.ReadNode().AsMap());
+			settings_loaded = true;
 		} else {
 			throw std::invalid_argument("Incorrect root node_name - " + node_name);
 		}
+	});
+
+	if(build_router){
+		BuildRoutes();
+	} else {
+		BuildGraph();
 	}
+}
 
-	//Заполним ребра на основе первичных данных
-	for(const auto& [_, bus]: buses){
-		if(bus.route_type == RouteType::Line){
-			FillEdgesLine(bus);
-		} else {
-			FillEdgesRound(bus);
-		}
+void BusManager::BuildRoutes(){
+	if(routes_built){
+		return;
 	}
 
-	return *this;
+	BuildGraph();
+	BuildRouter();
+	ReportMemory("router");
 }
 
-void BusManager::WriteResponse(std::ostream& out) const {
-	size_t vertex_count = last_init_id;
-	Graph::DirectedWeightedGraph<double> graph(vertex_count);
+void BusManager::BuildGraph(){
+	if(graph_built){
+		return;
+	}
 
-	std::cout << "vertex_count - " << vertex_count << std::endl;
-	std::cout << "edges_count - " << edges.size() << std::endl;
+	stop_distances.AddReverseDirections();
+	BuildNameIndexes();
+	FillStopBuses();
+	FillStopFragments();
+	FillBusStats();
 
-	if(logging){
-		std::cout << "edges list\n";
+	//Заполним ребра на основе первичных данных
+	FillVertices();
+	FillEdges();
+	ApplyVertexOrder();
+	graph_built = true;
+	ReportMemory("graph");
+}
+
+//Набор имен после загрузки не меняется, запросы ищут имена по совершенному хешу
+void BusManager::BuildNameIndexes(){
+	std::vector<std::string_view> names;
+	names.reserve(stops.size());
+	for(const Stop& stop: stops){
+		names.push_back(stop.name);
 	}
-	for(const auto& [from, to, distance, route_item_type]: edges){
-		if(logging){
-			std::cout << "from - " << from << ", to - " << to << "; distance - " << distance << "; route_item_type - "
-					<< (route_item_type == RouteItemType::Bus ? "Bus" : "Wait") << std::endl;
-		}
-		graph.AddEdge({from, to, distance, route_item_type});
+	stop_index.Build(names);
+
+	names.clear();
+	for(const Bus& bus: buses){
+		names.push_back(bus.name);
 	}
+	bus_index.Build(names);
+}
 
-	if(logging){
-		std::cout << std::endl;
-		std::cout << "vertex_to_bus_stop count - " << vertex_to_bus_stop.size() << "\n";
-		for(const auto& [vertex_id, bus_to_stop_set]: vertex_to_bus_stop){
-			std::cout << "vertex_id - " << vertex_id << std::endl;
-			for(const auto& bus_to_stop: bus_to_stop_set){
-				std::cout << "\t\tbus_to_stop.bus_name - " << bus_to_stop.bus_name
-									<< "; bus_to_stop_name - " << bus_to_stop.stop_name << std::endl;
+void BusManager::FillStopBuses(){
+	//Обходим маршруты в порядке имен, тогда списки остановок сразу отсортированы
+	std::vector<uint32_t> buses_by_name(buses.size());
+	std::iota(buses_by_name.begin(), buses_by_name.end(), 0);
+	std::sort(buses_by_name.begin(), buses_by_name.end(), [this](uint32_t lhs, uint32_t rhs){
+		return buses[lhs].name < buses[rhs].name;
+	});
+
+	stop_to_buses.assign(stops.size(), {});
+	for(const uint32_t bus_id: buses_by_name){
+		for(const uint32_t stop_id: buses[bus_id].stops){
+			std::vector<uint32_t>& stop_buses = stop_to_buses[stop_id];
+			if(stop_buses.empty() || stop_buses.back() != bus_id){
+				stop_buses.push_back(bus_id);
 			}
 		}
+	}
+}
 
-		std::cout << std::endl;
-		std::cout << "stop_to_bus_vertex count - " << stop_to_bus_vertex.size() << "\n";
-		for(const auto& [stop_name, bus_vertex_set]: stop_to_bus_vertex){
-			std::cout << "stop_name - " << stop_name  << std::endl;
-			for(const auto& bus_vertex: bus_vertex_set){
-				std::cout << "\t\t" << "vertex_id - " << bus_vertex.vertex_id << "; bus_name - " << bus_vertex.bus_name << std::endl;
+//Массивы пишутся тем же ResponseWriter и на той же глубине, что и в ответе: вершина - массив ответов,
+//в нем объект ответа. Между массивами он вставляет ключи и запятые, их вырезаем
+void BusManager::FillStopFragments(){
+	for(const ResponseWriter::Format format: {ResponseWriter::Format::Pretty, ResponseWriter::Format::Compact}){
+		std::vector<size_t> begins(stops.size()), ends(stops.size());
+		std::ostringstream out;
+		StopFragments& fragments = stop_fragments[static_cast<size_t>(format)];
+		{
+			ResponseWriter writer(out, format);
+			writer.BeginArray().BeginObject();
+			for(uint32_t stop_id = 0; stop_id < stops.size(); stop_id++){
+				writer.Key("buses");
+				begins[stop_id] = writer.GetBytesWritten();
+				fragments.depth = writer.GetDepth();
+				writer.BeginArray();
+				for(const uint32_t bus_id: stop_to_buses[stop_id]){
+					writer.Value(buses[bus_id].name);
+				}
+				writer.EndArray();
+				ends[stop_id] = writer.GetBytesWritten();
 			}
+			writer.EndObject().EndArray();
 		}
 
-		std::cout << std::endl;
-		std::cout << "bus_stop_to_vertex count - " << bus_stop_to_vertex.size() << "\n";
-		for(const auto& [bus_stop, vertex_id]: bus_stop_to_vertex){
-			std::cout << "vertex_id - " << vertex_id << ", bus_name - " << bus_stop.bus_name
-					<< "; stop_id - " << bus_stop.stop_id
-					<< "; stop_name - " << bus_stop.stop_name << std::endl;
+		const std::string written = out.str();
+		fragments.json.clear();
+		fragments.offsets.assign(1, 0);
+		fragments.offsets.reserve(stops.size() + 1);
+		for(uint32_t stop_id = 0; stop_id < stops.size(); stop_id++){
+			fragments.json.append(written, begins[stop_id], ends[stop_id] - begins[stop_id]);
+			fragments.offsets.push_back(fragments.json.size());
 		}
+		fragments.json.shrink_to_fit();
 	}
+}
 
-	Graph::Router<double> router(graph);
-	//return;
+//Маршруты независимы, считаем параллельно
+void BusManager::FillBusStats(){
+	bus_stats.resize(buses.size());
+	ParallelFor(buses.size(), [this](size_t bus_id){
+		const Bus& bus = buses[bus_id];
+		BusStats& stats = bus_stats[bus_id];
+		stats.stop_count = bus.GetSize();
+		stats.unique_stop_count = bus.unique_stops_count;
+		stats.route_length = GetDistanceByStops(bus);
+		stats.geo_length = GetDistanceByGeo(bus);
+		stats.curvature = stats.route_length / stats.geo_length;
+	});
+}
 
-	//out << std::fixed << std::setprecision(6) << "[\n";
-	out << "[\n";
+void BusManager::SaveSnapshot(std::ostream& out) const {
+	SnapshotWriter writer;
+	writer.Write(SNAPSHOT_MAGIC);
+	writer.Write(SNAPSHOT_VERSION);
+	writer.Write(settings);
+
+	writer.Write(static_cast<uint32_t>(stops.size()));
+	for(const Stop& stop: stops){
+		writer.WriteString(stop.name);
+		writer.Write(stop.declared);
+		writer.Write(stop.point);
+	}
 
-	size_t count = commands.size();
-	size_t n = 0;
-	for(const auto& command: commands){
-		out << "\t{\n";
-		out << "\t\t\"request_id\": " << command->id << ",\n";
-		if(command->GetType() == CommandType::Bus){
-			if(const auto it = buses.find(((BusCommand*)(command.get()))->name); it == buses.end()){
-				out << "\t\t\"error_message\": \"not found\"\n";
-			} else {
-				size_t distance_by_stops = GetDistanceByStops(it->second);
-				out << "\t\t\"stop_count\": " << it->second.GetSize() << ",\n";
-				out << "\t\t\"unique_stop_count\": " << it->second.unique_stops_count << ",\n";
-				out << "\t\t\"route_length\": " << distance_by_stops << ",\n";
-				out << "\t\t\"curvature\": " << distance_by_stops / GetDistanceByGeo(it->second) << "\n";
-			}
-		} else if(command->GetType() == CommandType::Stop){
-			if(const auto it = stop_to_buses.find(((StopCommand*)(command.get()))->name); it == stop_to_buses.end()){
-				out << "\t\t\"error_message\": \"not found\"\n";
-			} else if(it->second.size() == 0) {
-				out << "\t\t\"buses\": []\n";
-			} else {
-				size_t bus_count = it->second.size();
-				size_t b = 0;
-				out << "\t\t\"buses\": [\n";
-				for(const auto& item: it->second){
-					out << "\t\t\t\"" << item << "\"";
-					if(++b < bus_count){
-						out << ",\n";
-					}
-				}
-				out << "\n\t\t]\n";
-			}
-		} else if(command->GetType() == CommandType::Route){
-			RouteCommand rc = *(RouteCommand*)(command.get());
-			if(rc.stop_from == rc.stop_to){
-				out << "\t\t\"total_time\": 0,\n\t\t\"items\": []\n";
-			} else {
-				Route route = BuildBestRoute(rc, graph, router);
-
-				if(route.items.size() == 0){
-					out << "\t\t\"error_message\": \"not found\"\n";
-				} else {
-					out << "\t\t\"total_time\": " << route.total_time << ",\n";
-
-					size_t items_count = route.items.size();
-					size_t n = 0;
-					out << "\t\t\"items\": [\n";
-					for(const auto& item: route.items){
-						item->Print(out);
-						if(++n < items_count){
-							out << ",\n";
-						}
-					}
-					out << "\n\t\t]\n";
-				}
-			}
-		}
-		out << "\t}";
-		if(++n < count) {
-			out << ",\n";
+	writer.Write(static_cast<uint32_t>(buses.size()));
+	for(const Bus& bus: buses){
+		writer.WriteString(bus.name);
+		writer.Write(bus.route_type);
+		writer.Write(static_cast<uint32_t>(bus.unique_stops_count));
+		writer.Write(static_cast<uint32_t>(bus.stops.size()));
+		for(const uint32_t stop_id: bus.stops){
+			writer.Write(stop_id);
 		}
 	}
-	out << "\n]";
+
+	writer.Write(static_cast<uint64_t>(stop_distances.Size()));
+	stop_distances.ForEach([&writer](uint32_t stop_from, uint32_t stop_to, uint64_t distance){
+		writer.Write(stop_from);
+		writer.Write(stop_to);
+		writer.Write(distance);
+	});
+
+	//Вершины однозначно следуют из маршрутов, хранятся только ребра и перенумерация, если была
+	writer.Write(static_cast<uint64_t>(edges.size()));
+	for(const auto& edge: edges){
+		writer.Write(static_cast<uint64_t>(edge.from));
+		writer.Write(static_cast<uint64_t>(edge.to));
+		writer.Write(edge.distance);
+		writer.Write(edge.route_item_type);
+		writer.Write(edge.bus_id);
+	}
+
+	writer.Write(static_cast<uint64_t>(original_vertex_ids.size()));
+	for(const Graph::VertexId vertex_id: original_vertex_ids){
+		writer.Write(static_cast<uint64_t>(vertex_id));
+	}
+
+	writer.Flush(out);
 }
 
-Route BusManager::BuildBestRoute(const RouteCommand& command,
-			const Graph::DirectedWeightedGraph<double>& graph,
-			Graph::Router<double>& router) const {
+BusManager& BusManager::LoadSnapshot(std::istream& in){
+	SnapshotReader reader(ReadWholeStream(in));
+	if(reader.Read<uint64_t>() != SNAPSHOT_MAGIC){
+		throw std::invalid_argument("BusManager::LoadSnapshot: not a snapshot");
+	}
+	if(const uint32_t version = reader.Read<uint32_t>(); version != SNAPSHOT_VERSION){
+		throw std::invalid_argument("BusManager::LoadSnapshot: unsupported version " + std::to_string(version));
+	}
+	settings = reader.Read<RoutingSettings>();
+
+	stops.resize(reader.Read<uint32_t>());
+	for(uint32_t stop_id = 0; stop_id < stops.size(); stop_id++){
+		Stop& stop = stops[stop_id];
+		stop.id = stop_id;
+		stop.name = reader.ReadString();
+		stop.declared = reader.Read<bool>();
+		stop.point = reader.Read<Point>();
+		stop.geo = GeoPoint(stop.point);
+		stop_ids.emplace(stop.name, stop_id);
+	}
 
-	Route route;
-	route.total_time = -1.0;
+	buses.resize(reader.Read<uint32_t>());
+	for(uint32_t bus_id = 0; bus_id < buses.size(); bus_id++){
+		Bus& bus = buses[bus_id];
+		bus.name = reader.ReadString();
+		bus.route_type = reader.Read<RouteType>();
+		bus.unique_stops_count = reader.Read<uint32_t>();
+		bus.stops.resize(reader.Read<uint32_t>());
+		for(uint32_t& stop_id: bus.stops){
+			stop_id = reader.Read<uint32_t>();
+			if(stop_id >= stops.size()){
+				throw std::invalid_argument("BusManager::LoadSnapshot: bad stop id");
+			}
+		}
+		bus_ids.emplace(bus.name, bus_id);
+	}
 
-	std::vector<Graph::VertexId> vertex_from_list;
-	if(auto it = stop_to_buses.find(command.stop_from); it != stop_to_buses.end()){
-		for(const std::string& bus_name: it->second){
-			const Bus& bus = buses.at(bus_name);
-			const std::vector<Bus::Stop>& stops = bus.stops;
-
-			//В круговых маршрутах допускается несколько остановок с одинаковым названием. Находим их все
-			auto it = stops.begin();
-			while(true){
-				it = std::find_if(it, stops.end(), [&](const Bus::Stop& stop){return stop.stop_name == command.stop_from;});
-				if(it == stops.end()){
-					break;;
-				}
+	const uint64_t distance_count = reader.Read<uint64_t>();
+	stop_distances.Reserve(distance_count);
+	for(uint64_t i = 0; i < distance_count; i++){
+		const uint32_t stop_from = reader.Read<uint32_t>();
+		const uint32_t stop_to = reader.Read<uint32_t>();
+		stop_distances.Insert(stop_from, stop_to, reader.Read<uint64_t>());
+	}
 
-				if(auto it_bus_stop = bus_stop_to_vertex.find({bus_name, it->stop_id}); it_bus_stop != bus_stop_to_vertex.end()){
-					vertex_from_list.push_back(it_bus_stop->second);
-				}
+	FillVertices();
+
+	const uint64_t edge_count = reader.Read<uint64_t>();
+	edges.reserve(edge_count);
+	for(uint64_t i = 0; i < edge_count; i++){
+		Edge edge;
+		edge.from = reader.Read<uint64_t>();
+		edge.to = reader.Read<uint64_t>();
+		edge.distance = reader.Read<double>();
+		edge.route_item_type = reader.Read<RouteItemType>();
+		edge.bus_id = reader.Read<uint32_t>();
+		if(edge.from >= last_init_id || edge.to >= last_init_id || edge.bus_id >= buses.size()){
+			throw std::invalid_argument("BusManager::LoadSnapshot: bad edge");
+		}
+		edges.push_back(edge);
+	}
 
-				it = it + 1;
+	//Ребра уже в новой нумерации, переставляем только метаданные вершин
+	if(const uint64_t order_size = reader.Read<uint64_t>(); order_size > 0){
+		if(order_size != last_init_id){
+			throw std::invalid_argument("BusManager::LoadSnapshot: bad vertex order");
+		}
+		std::vector<Graph::VertexId> order(order_size);
+		std::vector<bool> seen(order_size, false);
+		for(Graph::VertexId& vertex_id: order){
+			vertex_id = reader.Read<uint64_t>();
+			if(vertex_id >= order_size || seen[vertex_id]){
+				throw std::invalid_argument("BusManager::LoadSnapshot: bad vertex order");
 			}
+			seen[vertex_id] = true;
 		}
+		RenumberVertices(std::move(order));
 	}
 
-	if(vertex_from_list.size() == 0){
-		return route;
+	if(!reader.AtEnd()){
+		throw std::invalid_argument("BusManager::LoadSnapshot: trailing data");
 	}
 
-	std::vector<Graph::VertexId> vertex_to_list;
-	if(auto it = stop_to_buses.find(command.stop_to); it != stop_to_buses.end()){
-		for(const std::string& bus_name: it->second){
-			const Bus& bus = buses.at(bus_name);
-			const std::vector<Bus::Stop>& stops = bus.stops;
+	BuildNameIndexes();
+	FillStopBuses();
+	FillStopFragments();
+	FillBusStats();
+	graph_built = true;
+	ReportMemory("snapshot");
+
+	//Таблицы маршрутизаторов - основная часть загрузки, в снимке их нет: загрузка их не ждет.
+	//Отчету о памяти нужны готовые таблицы, с ним строим сразу
+	BuildRouter(memory_report == nullptr);
+	ReportMemory("router");
+	return *this;
+}
 
-			auto it = stops.begin();
-			while(true){
-				it = std::find_if(it, stops.end(), [&](const Bus::Stop& stop){return stop.stop_name == command.stop_to;});
-				if(it == stops.end()){
-					break;;
-				}
+BusManager& BusManager::SetResponseFormat(ResponseWriter::Format format){
+	response_format = format;
+	return *this;
+}
 
-				if(auto it_bus_stop = bus_stop_to_vertex.find({bus_name, it->stop_id}); it_bus_stop != bus_stop_to_vertex.end()){
-					vertex_to_list.push_back(it_bus_stop->second);
-				}
+BusManager& BusManager::SetVertexOrder(VertexOrder order){
+	vertex_order = order;
+	return *this;
+}
 
-				it = it + 1;
-			}
+BusManager& BusManager::SetMemoryReport(std::ostream* out){
+	memory_report = out;
+	return *this;
+}
+
+std::vector<MemoryUsageEntry> BusManager::CollectMemoryUsage() const {
+	std::vector<MemoryUsageEntry> result;
+
+	size_t stop_bytes = VectorMemoryUsage(stops);
+	for(const Stop& stop: stops){
+		stop_bytes += StringMemoryUsage(stop.name);
+	}
+	result.push_back({"stops", stops.size(), stops.capacity(), stop_bytes});
+
+	size_t bus_bytes = VectorMemoryUsage(buses);
+	for(const Bus& bus: buses){
+		bus_bytes += StringMemoryUsage(bus.name) + VectorMemoryUsage(bus.stops);
+	}
+	result.push_back({"buses", buses.size(), buses.capacity(), bus_bytes});
+
+	for(const auto& [name, ids]: {std::pair{"stop_ids", &stop_ids}, std::pair{"bus_ids", &bus_ids}}){
+		size_t bytes = UnorderedMapMemoryUsage(*ids);
+		for(const auto& [key, _]: *ids){
+			bytes += StringMemoryUsage(key);
 		}
+		result.push_back({name, ids->size(), ids->bucket_count(), bytes, ids->load_factor()});
 	}
 
-	if(vertex_to_list.size() == 0){
-		return route;
+	result.push_back({"stop_index", stop_index.Size(), stop_index.Size(), stop_index.MemoryUsage()});
+	result.push_back({"bus_index", bus_index.Size(), bus_index.Size(), bus_index.MemoryUsage()});
+
+	size_t stop_to_buses_bytes = VectorMemoryUsage(stop_to_buses);
+	size_t stop_to_buses_count = 0;
+	size_t stop_to_buses_capacity = 0;
+	for(const auto& stop_buses: stop_to_buses){
+		stop_to_buses_bytes += VectorMemoryUsage(stop_buses);
+		stop_to_buses_count += stop_buses.size();
+		stop_to_buses_capacity += stop_buses.capacity();
+	}
+	result.push_back({"stop_to_buses", stop_to_buses_count, stop_to_buses_capacity, stop_to_buses_bytes});
+	size_t stop_fragments_bytes = 0;
+	for(const StopFragments& fragments: stop_fragments){
+		stop_fragments_bytes += StringMemoryUsage(fragments.json) + VectorMemoryUsage(fragments.offsets);
+	}
+	result.push_back({"stop_fragments", stop_fragments[0].json.size() + stop_fragments[1].json.size(),
+			stop_fragments[0].json.capacity() + stop_fragments[1].json.capacity(), stop_fragments_bytes});
+
+	result.push_back({"stop_distances", stop_distances.Size(), stop_distances.Capacity(), stop_distances.MemoryUsage(),
+			stop_distances.Capacity() == 0 ? 0.0 : static_cast<double>(stop_distances.Size()) / stop_distances.Capacity()});
+	result.push_back({"bus_stats", bus_stats.size(), bus_stats.capacity(), VectorMemoryUsage(bus_stats)});
+
+	result.push_back({"vertices", vertices.size(), vertices.capacity(), VectorMemoryUsage(vertices)});
+	result.push_back({"bus_first_vertex", bus_first_vertex.size(), bus_first_vertex.capacity(), VectorMemoryUsage(bus_first_vertex)});
+	result.push_back({"original_vertex_ids", original_vertex_ids.size(), original_vertex_ids.capacity(),
+			VectorMemoryUsage(original_vertex_ids)});
+	result.push_back({"stop_vertices", stop_vertex_ids.size(), stop_vertex_ids.capacity(),
+			VectorMemoryUsage(stop_vertex_ids) + VectorMemoryUsage(stop_vertex_offsets)});
+	result.push_back({"edges", edges.size(), edges.capacity(), VectorMemoryUsage(edges)});
+	result.push_back({"chains", chains.size(), chains.capacity(),
+			VectorMemoryUsage(chains) + VectorMemoryUsage(chain_weights) + VectorMemoryUsage(chain_times)
+			+ VectorMemoryUsage(vertex_places)});
+	result.push_back({"core_edges", core_edges.size(), core_edges.capacity(),
+			VectorMemoryUsage(core_edges) + VectorMemoryUsage(core_edge_chains) + VectorMemoryUsage(core_vertices)});
+
+	if(routes_built){
+		//Графы и маршрутизаторы всех компонент вместе; ячеек таблицы - сумма квадратов размеров
+		size_t graph_edge_count = 0, graph_bytes = 0;
+		size_t router_cell_count = 0, router_bytes = 0;
+		for(const RoutingComponent& component: components){
+			const size_t vertex_count = component.graph->GetVertexCount();
+			graph_edge_count += component.graph->GetEdgeCount();
+			graph_bytes += component.graph->GetMemoryUsage() + VectorMemoryUsage(component.core_edge_ids);
+			//Еще не построенный маршрутизатор места не занимает
+			if(component.router){
+				router_cell_count += vertex_count * vertex_count;
+				router_bytes += component.router->GetMemoryUsage();
+			}
+		}
+		result.push_back({"components", components.size(), components.capacity(),
+				VectorMemoryUsage(components) + VectorMemoryUsage(core_components) + VectorMemoryUsage(core_local_ids)
+				+ VectorMemoryUsage(stop_components)});
+		result.push_back({"graph", graph_edge_count, graph_edge_count, graph_bytes});
+		result.push_back({"router", router_cell_count, router_cell_count, router_bytes});
 	}
 
-	std::vector<Graph::EdgeId> route_edges;
-	for(const Graph::VertexId vertex_from: vertex_from_list){
-		for(const Graph::VertexId vertex_to: vertex_to_list){
-			auto route_info = router.BuildRoute(vertex_from, vertex_to);
-			if(!route_info || route_info->edge_count < 1){
-				continue;
-			} else if(route.total_time < 0 || route_info->weight < route.total_time) {
-				route_edges.clear();
+	result.push_back({"commands", commands.size(), commands.capacity(), VectorMemoryUsage(commands)});
+	if(json_arena_size > 0){
+		result.push_back({"json_arena", 1, 1, json_arena_size});
+	}
+	return result;
+}
 
-				route.total_time = route_info->weight;
-				for(size_t i = 0; i < route_info->edge_count; i++) {
-					route_edges.push_back(router.GetRouteEdge(route_info->id, i));
-				}
+void BusManager::WriteMemoryReport(std::ostream& out, std::string_view phase) const {
+	const std::vector<MemoryUsageEntry> entries = CollectMemoryUsage();
+	size_t total_bytes = 0;
+	for(const MemoryUsageEntry& entry: entries){
+		total_bytes += entry.bytes;
+	}
 
-				router.ReleaseRoute(route_info->id);
+	{
+		ResponseWriter writer(out, ResponseWriter::Format::Compact);
+		writer.BeginObject();
+		writer.Key("phase").Value(phase);
+		writer.Key("total_bytes").Value(total_bytes);
+		writer.Key("structures").BeginArray();
+		for(const MemoryUsageEntry& entry: entries){
+			writer.BeginObject();
+			writer.Key("name").Value(entry.name);
+			writer.Key("count").Value(entry.count);
+			writer.Key("capacity").Value(entry.capacity);
+			writer.Key("bytes").Value(entry.bytes);
+			if(entry.load_factor >= 0){
+				writer.Key("load_factor").Value(entry.load_factor);
 			}
+			writer.EndObject();
 		}
+		writer.EndArray();
+		writer.EndObject();
 	}
+	out << '\n';
+}
+
+void BusManager::WriteMemoryReport(std::ostream& out) const {
+	WriteMemoryReport(out, "current");
+}
 
-	if(route_edges.size() == 0){
-		return route;
+void BusManager::ReportMemory(std::string_view phase) const {
+	if(memory_report != nullptr){
+		WriteMemoryReport(*memory_report, phase);
 	}
+}
 
-	route.total_time += settings.bus_wait_time;
+void BusManager::BuildRouter(bool background){
+	if(router_builder.joinable()){
+		router_builder.join();
+	}
 
-	RouteItemWait rw;
-	rw.stop_name = command.stop_from;
-	rw.bus_wait_time = settings.bus_wait_time;
+	CompressChains();
+	SplitComponents();
 
-	route.items.push_back(std::make_shared<RouteItemWait>(rw));
+	if(logging){
+		std::cout << "vertex_count - " << last_init_id << ", core - " << core_vertices.size()
+				<< ", components - " << components.size() << std::endl;
+		std::cout << "edges_count - " << edges.size() << ", core - " << core_edges.size() << std::endl;
+		std::cout << "edges list\n";
+		for(const auto& [from, to, distance, route_item_type, bus_id]: edges){
+			std::cout << "from - " << from << ", to - " << to << "; distance - " << distance << "; route_item_type - "
+					<< (route_item_type == RouteItemType::Bus ? "Bus" : "Wait") << "; bus_name - " << buses[bus_id].name << std::endl;
+		}
+	}
+	if(logging){
+		std::cout << std::endl;
+		std::cout << "vertices count - " << vertices.size() << "\n";
+		for(size_t vertex_id = 0; vertex_id < vertices.size(); vertex_id++){
+			const VertexInfo& vertex = vertices[vertex_id];
+			std::cout << "vertex_id - " << vertex_id << ", bus_name - " << buses[vertex.bus_id].name
+					<< "; stop_id - " << vertex.position
+					<< "; stop_name - " << stops[vertex.stop_id].name << std::endl;
+		}
 
-	auto it_route_edges_begin = route_edges.begin();
-	auto it_route_edges_end = route_edges.end();
+		std::cout << std::endl;
+		std::cout << "stop_vertex_ids count - " << stop_vertex_ids.size() << "\n";
+		for(uint32_t stop_id = 0; stop_id < stops.size(); stop_id++){
+			std::cout << "stop_name - " << stops[stop_id].name  << std::endl;
+			for(const Graph::VertexId vertex_id: GetStopVertices(stop_id)){
+				std::cout << "\t\t" << "vertex_id - " << vertex_id << "; bus_name - " << buses[vertices[vertex_id].bus_id].name << std::endl;
+			}
+		}
+	}
 
-	while(true) {
-		auto it_route_edges_end_current = std::find_if(it_route_edges_begin, it_route_edges_end, [&](const Graph::EdgeId& edge_id) {
-			const Graph::Edge<double>& edge = graph.GetEdge(edge_id);
-			return edge.route_item_type == RouteItemType::Wait;
+	//Маршрутизаторы компонент независимы, строим параллельно
+	auto build_routers = [this]{
+		ParallelFor(components.size(), [this](size_t component_id){
+			GetComponentRouter(components[component_id]);
+		}, 1);
+	};
+	if(background){
+		router_builder = std::thread([build_routers]{
+			//Неудачу повторит и сообщит запрос к этой компоненте: call_once после исключения не срабатывает
+			try {
+				build_routers();
+			} catch(const std::exception&){
+			}
 		});
+	} else {
+		build_routers();
+	}
+	routes_built = true;
+}
 
-		const Graph::Edge<double>& edge = graph.GetEdge(*it_route_edges_begin);
-		const auto& bus_stop_from_set = vertex_to_bus_stop.at(edge.from);
-		const auto& bus_stop_to_set = vertex_to_bus_stop.at(edge.to);
+Graph::Router<double>& BusManager::GetComponentRouter(const RoutingComponent& component) const {
+	std::call_once(*component.router_once, [&component]{
+		component.router = std::make_unique<Graph::Router<double>>(*component.graph);
+	});
+	return *component.router;
+}
 
-		std::vector<std::string> bus_range_list;
-		std::transform(bus_stop_from_set.begin(), bus_stop_from_set.end(), std::back_inserter(bus_range_list),
-				[](const BusStop& bus_stop){
-				return bus_stop.bus_name;
-		});
+void BusManager::WriteResponse(std::ostream& out) const {
+	ResponseWriter writer(out, response_format);
+	writer.BeginArray();
+	for(const auto& command: commands){
+		WriteResponse(*command, writer);
+	}
+	writer.EndArray();
+}
 
-		uint32_t span_count = std::distance(it_route_edges_begin, it_route_edges_end_current);
-		double bus_move_time = edge.weight;
+//Запрос разбирается до записи: при ошибке в writer ничего не попадает
+void BusManager::WriteResponse(const Json::Map& request, ResponseWriter& writer) const {
+	WriteResponse(*ReadRequest(request), writer);
+}
+
+void BusManager::WriteResponse(const Command& command, ResponseWriter& writer) const {
+	writer.BeginObject();
+	writer.Key("request_id").Value(command.id);
+	if(command.GetType() == CommandType::Bus){
+		if(const auto bus_id = bus_index.Find(static_cast<const BusCommand&>(command).name); !bus_id){
+			writer.Key("error_message").Value("not found");
+		} else {
+			const BusStats& stats = bus_stats[*bus_id];
+			writer.Key("stop_count").Value(stats.stop_count);
+			writer.Key("unique_stop_count").Value(stats.unique_stop_count);
+			writer.Key("route_length").Value(stats.route_length);
+			writer.Key("curvature").Value(stats.curvature);
+		}
+	} else if(command.GetType() == CommandType::Stop){
+		const auto stop_id = stop_index.Find(static_cast<const StopCommand&>(command).name);
+		if(!stop_id || (!stops[*stop_id].declared && stop_to_buses[*stop_id].empty())){
+			writer.Key("error_message").Value("not found");
+		} else {
+			writer.Key("buses");
+			if(const StopFragments& fragments = stop_fragments[static_cast<size_t>(writer.GetFormat())];
+					writer.GetFormat() == ResponseWriter::Format::Compact || writer.GetDepth() == fragments.depth){
+				const size_t begin = fragments.offsets[*stop_id];
+				writer.RawValue(std::string_view(fragments.json).substr(begin, fragments.offsets[*stop_id + 1] - begin));
+			} else {
+				writer.BeginArray();
+				for(const uint32_t bus_id: stop_to_buses[*stop_id]){
+					writer.Value(buses[bus_id].name);
+				}
+				writer.EndArray();
+			}
+		}
+	} else if(command.GetType() == CommandType::Route){
+		const RouteCommand& rc = static_cast<const RouteCommand&>(command);
+		if(rc.stop_from == rc.stop_to){
+			writer.Key("total_time").Value(0);
+			writer.Key("items").BeginArray().EndArray();
+		} else {
+			RouteBuffers& buffers = GetRouteBuffers();
+			BuildBestRoute(rc, buffers);
+			const Route& route = buffers.route;
+
+			if(route.items.size() == 0){
+				writer.Key("error_message").Value("not found");
+			} else {
+				writer.Key("total_time").Value(route.total_time);
+				writer.Key("items").BeginArray();
+				for(const RouteItem& item: route.items){
+					std::visit([this, &writer](const auto& typed_item){
+						WriteRouteItem(typed_item, writer);
+					}, item);
+				}
+				writer.EndArray();
+			}
+		}
+	}
+	writer.EndObject();
+}
+
+Range<const Graph::VertexId*> BusManager::GetStopVertices(uint32_t stop_id) const {
+	const Graph::VertexId* data = stop_vertex_ids.data();
+	return {data + stop_vertex_offsets[stop_id], data + stop_vertex_offsets[stop_id + 1]};
+}
+
+void BusManager::WriteRouteItem(const RouteItemWait& item, ResponseWriter& writer) const {
+	writer.BeginObject()
+		.Key("type").Value("Wait")
+		.Key("stop_name").Value(stops[item.stop_id].name)
+		.Key("time").Value(item.bus_wait_time)
+		.EndObject();
+}
 
-		std::string stop_to = bus_stop_to_set.begin()->stop_name;
-		for(auto it = ++it_route_edges_begin; it != it_route_edges_end_current; ++it ){
-			const Graph::Edge<double>& edge = graph.GetEdge(*it);
-			bus_move_time += edge.weight;
+void BusManager::WriteRouteItem(const RouteItemBus& item, ResponseWriter& writer) const {
+	writer.BeginObject()
+		.Key("type").Value("Bus")
+		.Key("bus").Value(buses[item.bus_id].name)
+		.Key("span_count").Value(item.span_count)
+		.Key("time").Value(item.bus_move_time)
+		.EndObject();
+}
 
-			const auto& bus_stop_from_set = vertex_to_bus_stop.at(edge.from);
-			const auto& bus_stop_to_set = vertex_to_bus_stop.at(edge.to);
+//Векторы сохраняют емкость между запросами; у каждого потока свои
+BusManager::RouteBuffers& BusManager::GetRouteBuffers(){
+	thread_local RouteBuffers buffers;
+	return buffers;
+}
 
-			stop_to = bus_stop_to_set.begin()->stop_name;
+void BusManager::BuildBestRoute(const RouteCommand& command, RouteBuffers& buffers) const {
+	Route& route = buffers.route;
+	route.total_time = -1.0;
+	route.items.clear();
 
-			std::vector<std::string> buses_for_delete;
-			for(const std::string& bus_name: bus_range_list){
-				bool found = false;
-				for(const BusStop& bus_stop: bus_stop_from_set){
-					if(bus_name == bus_stop.bus_name){
-						found = true;
-						break;
+	const auto stop_from = stop_index.Find(command.stop_from);
+	const auto stop_to = stop_index.Find(command.stop_to);
+	if(!stop_from || !stop_to){
+		return;
+	}
+
+	//Остановки в разных компонентах: пути нет без всякого поиска
+	const uint32_t component_id = stop_components[*stop_from];
+	if(component_id == NO_COMPONENT || component_id != stop_components[*stop_to]){
+		return;
+	}
+	const RoutingComponent& component = components[component_id];
+	const Graph::DirectedWeightedGraph<double>& graph = *component.graph;
+	const Graph::Router<double>& router = GetComponentRouter(component);
+
+	const auto vertex_from_list = GetStopVertices(*stop_from);
+	const auto vertex_to_list = GetStopVertices(*stop_to);
+
+	//Лучший путь ищется так же по парам вершин, но через граф опорных вершин:
+	//выход из цепочки, путь по маршрутизатору, вход в цепочку; либо прямо по одной цепочке.
+	//Выходы и входы зависят только от своей вершины - считаются один раз до перебора пар
+	std::vector<CoreLinks>& exits = buffers.exits;
+	exits.clear();
+	for(const Graph::VertexId vertex_from: vertex_from_list){
+		exits.push_back(GetCoreExits(vertex_from));
+	}
+	std::vector<CoreLinks>& entries = buffers.entries;
+	entries.clear();
+	for(const Graph::VertexId vertex_to: vertex_to_list){
+		entries.push_back(GetCoreEntries(vertex_to));
+	}
+
+	std::optional<ChainWalk> best_direct;
+	CoreLink best_exit{};
+	CoreLink best_entry{};
+	const CoreLinks* next_exits = exits.data();
+	for(const Graph::VertexId vertex_from: vertex_from_list){
+		const CoreLinks& vertex_exits = *next_exits++;
+		const CoreLinks* next_entries = entries.data();
+		for(const Graph::VertexId vertex_to: vertex_to_list){
+			const CoreLinks& vertex_entries = *next_entries++;
+
+			double pair_time = -1.0;
+			std::optional<ChainWalk> pair_direct = GetDirectWalk(vertex_from, vertex_to);
+			if(pair_direct){
+				pair_time = GetWalkTime(*pair_direct);
+			}
+			const CoreLink* pair_exit = nullptr;
+			const CoreLink* pair_entry = nullptr;
+			for(size_t i = 0; i < vertex_exits.count; i++){
+				const CoreLink& exit = vertex_exits.links[i];
+				for(size_t j = 0; j < vertex_entries.count; j++){
+					const CoreLink& entry = vertex_entries.links[j];
+					const auto core_time = router.GetRouteWeight(core_local_ids[exit.core_id], core_local_ids[entry.core_id]);
+					if(!core_time){
+						continue;
+					}
+					const double time = exit.time + *core_time + entry.time;
+					if(pair_time < 0 || time < pair_time){
+						pair_time = time;
+						pair_direct.reset();
+						pair_exit = &exit;
+						pair_entry = &entry;
 					}
 				}
+			}
 
-				if(!found){
-					buses_for_delete.push_back(bus_name);
+			//Путь без ребер - только из вершины в саму себя
+			if(pair_time < 0 || vertex_from == vertex_to){
+				continue;
+			}
+			if(route.total_time < 0 || pair_time < route.total_time){
+				route.total_time = pair_time;
+				best_direct = pair_direct;
+				if(!pair_direct){
+					best_exit = *pair_exit;
+					best_entry = *pair_entry;
 				}
 			}
+		}
+	}
+
+	if(route.total_time < 0){
+		return;
+	}
+
+	std::vector<RouteStep>& steps = buffers.steps;
+	steps.clear();
+	if(best_direct){
+		AppendWalkSteps(*best_direct, steps);
+	} else {
+		AppendWalkSteps(best_exit.walk, steps);
+		router.BuildRoute(core_local_ids[best_exit.core_id], core_local_ids[best_entry.core_id], buffers.edges);
+		for(const Graph::EdgeId edge_id: buffers.edges){
+			const Graph::Edge<double>& edge = graph.GetEdge(edge_id);
+			const size_t core_edge_id = component.core_edge_ids[edge_id];
+			if(const CoreEdgeChain& edge_chain = core_edge_chains[core_edge_id]; edge_chain.chain != NO_CHAIN){
+				const uint32_t span_count = chains[edge_chain.chain].span_count;
+				AppendWalkSteps(edge_chain.backward ? ChainWalk{edge_chain.chain, span_count, 0}
+						: ChainWalk{edge_chain.chain, 0, span_count}, steps);
+			} else {
+				steps.push_back({edge.route_item_type, edge.bus_id, vertices[core_vertices[core_edges[core_edge_id].from]].stop_id, edge.weight});
+			}
+		}
+		AppendWalkSteps(best_entry.walk, steps);
+	}
 
-			for(const std::string bus_for_felete: buses_for_delete){
-				auto p = std::remove(bus_range_list.begin(), bus_range_list.end(), bus_for_felete);
-				bus_range_list.erase(p, bus_range_list.end());
+	route.total_time += settings.bus_wait_time;
+	route.items.push_back(RouteItemWait{*stop_from, static_cast<uint32_t>(settings.bus_wait_time)});
+
+	//Один проход по ребрам: подряд идущие ребра поездки одного маршрута - один элемент Bus,
+	//ребра ожидания на одной остановке - один элемент Wait
+	for(const RouteStep& step: steps){
+		if(step.route_item_type == RouteItemType::Wait){
+			if(auto* last_wait = std::get_if<RouteItemWait>(&route.items.back()); last_wait != nullptr && last_wait->stop_id == step.stop_id){
+				last_wait->bus_wait_time += settings.bus_wait_time;
+				continue;
+			}
+			route.items.push_back(RouteItemWait{step.stop_id, static_cast<uint32_t>(settings.bus_wait_time)});
+		} else {
+			if(auto* last_bus = std::get_if<RouteItemBus>(&route.items.back()); last_bus != nullptr && last_bus->bus_id == step.bus_id){
+				last_bus->span_count++;
+				last_bus->bus_move_time += step.time;
+				continue;
 			}
+			route.items.push_back(RouteItemBus{step.bus_id, 1, step.time});
 		}
+	}
+}
+
+//Разность накопленных времен: не зависит от длины цепочки
+double BusManager::GetWalkTime(const ChainWalk& walk) const {
+	if(walk.chain == NO_CHAIN){
+		return 0.0;
+	}
 
-		assert(bus_range_list.size() > 0);
+	const Chain& chain = chains[walk.chain];
+	if(walk.offset_from < walk.offset_to){
+		return chain_times[chain.first_time + walk.offset_to] - chain_times[chain.first_time + walk.offset_from];
+	}
+	const size_t first_backward = chain.first_time + chain.span_count + 1;
+	return chain_times[first_backward + walk.offset_to] - chain_times[first_backward + walk.offset_from];
+}
 
-		RouteItemBus rb;
-		rb.bus_number = bus_range_list[0];
-		rb.span_count = span_count;
-		rb.bus_move_time = bus_move_time;
-		route.items.push_back(std::make_shared<RouteItemBus>(rb));
+void BusManager::AppendWalkSteps(const ChainWalk& walk, std::vector<RouteStep>& steps) const {
+	if(walk.chain == NO_CHAIN){
+		return;
+	}
 
-		if(it_route_edges_end_current == it_route_edges_end){
-			break;
+	const Chain& chain = chains[walk.chain];
+	if(walk.offset_from < walk.offset_to){
+		for(uint32_t i = walk.offset_from; i < walk.offset_to; i++){
+			steps.push_back({RouteItemType::Bus, chain.bus_id, 0, chain_weights[chain.first_weight + i]});
+		}
+	} else {
+		for(uint32_t i = walk.offset_from; i > walk.offset_to; i--){
+			steps.push_back({RouteItemType::Bus, chain.bus_id, 0, chain_weights[chain.first_weight + chain.span_count + i - 1]});
 		}
+	}
+}
 
-		RouteItemWait rw;
-		rw.stop_name = stop_to;
-		rw.bus_wait_time = settings.bus_wait_time;
+//Из внутренней вершины цепочки - вперед к ее концу, у линейного маршрута и назад к началу
+BusManager::CoreLinks BusManager::GetCoreExits(Graph::VertexId vertex_id) const {
+	CoreLinks result{};
+	const VertexPlace& place = vertex_places[vertex_id];
+	if(place.core_id != NO_CORE_VERTEX){
+		result.links[result.count++] = {place.core_id, 0.0, {}};
+		return result;
+	}
 
-		route.items.push_back(std::make_shared<RouteItemWait>(rw));
+	const Chain& chain = chains[place.chain];
+	const ChainWalk forward{place.chain, place.offset, chain.span_count};
+	result.links[result.count++] = {chain.to, GetWalkTime(forward), forward};
+	if(chain.two_way){
+		const ChainWalk backward{place.chain, place.offset, 0};
+		result.links[result.count++] = {chain.from, GetWalkTime(backward), backward};
+	}
+	return result;
+}
 
-		it_route_edges_begin = it_route_edges_end_current + 1;
+BusManager::CoreLinks BusManager::GetCoreEntries(Graph::VertexId vertex_id) const {
+	CoreLinks result{};
+	const VertexPlace& place = vertex_places[vertex_id];
+	if(place.core_id != NO_CORE_VERTEX){
+		result.links[result.count++] = {place.core_id, 0.0, {}};
+		return result;
 	}
 
-	return route;
+	const Chain& chain = chains[place.chain];
+	const ChainWalk forward{place.chain, 0, place.offset};
+	result.links[result.count++] = {chain.from, GetWalkTime(forward), forward};
+	if(chain.two_way){
+		const ChainWalk backward{place.chain, chain.span_count, place.offset};
+		result.links[result.count++] = {chain.to, GetWalkTime(backward), backward};
+	}
+	return result;
 }
 
-double BusManager::GetDistance(std::vector<std::string>::const_iterator it) const {
-	double bus_time;
-
-	if(auto it_distance_b = stop_distances.find(StopPair{*it, *(it+1)}); it_distance_b != stop_distances.end()) {
-		bus_time = it_distance_b->second / settings.bus_velocity;
-	} else if(auto it_distance_e = stop_distances.find(StopPair{*(it+1), *it});	it_distance_e != stop_distances.end()) {
-		bus_time = it_distance_e->second / settings.bus_velocity;
-	} else {
-		throw std::invalid_argument("Not found distance " + (*it) + " and " + (*(it+1)));
+//Обе вершины внутри одной цепочки: проезд прямо по ней, не выходя к опорным вершинам
+std::optional<BusManager::ChainWalk> BusManager::GetDirectWalk(Graph::VertexId from, Graph::VertexId to) const {
+	const VertexPlace& place_from = vertex_places[from];
+	const VertexPlace& place_to = vertex_places[to];
+	if(place_from.chain == NO_CHAIN || place_from.chain != place_to.chain || place_from.offset == place_to.offset){
+		return std::nullopt;
+	}
+	if(place_from.offset > place_to.offset && !chains[place_from.chain].two_way){
+		return std::nullopt;
 	}
+	return ChainWalk{place_from.chain, place_from.offset, place_to.offset};
+}
 
-	return bus_time;
+uint64_t BusManager::GetRoadDistance(uint32_t stop_from, uint32_t stop_to) const {
+	if(const auto distance = stop_distances.Find(stop_from, stop_to)){
+		return *distance;
+	}
+	throw std::invalid_argument("distance [" + stops[stop_from].name + ", " + stops[stop_to].name + "] not found");
 }
 
 size_t BusManager::GetDistanceByStops(const Bus& bus) const {
@@ -521,27 +1040,15 @@ size_t BusManager::GetDistanceByStops(const Bus& bus, bool forward) const {
 	size_t result = 0;
 	size_t stop_count =	bus.stops.size();
 
-	auto it_end = stop_distances.end();
 	size_t i = 0;
 	do{
 		size_t first_stop = forward ? i : i + 1;
 		size_t second_stop = forward ? i + 1 : i;
 
-		const Bus::Stop& bus_stop_1 = bus.stops[first_stop];
-		const Bus::Stop& bus_stop_2 = bus.stops[second_stop];
-
-		std::string stop_name_1 = bus_stop_1.stop_name;
-		std::string stop_name_2 = bus_stop_2.stop_name;
+		const uint32_t stop_1 = bus.stops[first_stop];
+		const uint32_t stop_2 = bus.stops[second_stop];
 
-		auto it = stop_distances.find({stop_name_1, stop_name_2});
-		if(it == it_end){
-			it = stop_distances.find({stop_name_2, stop_name_1});
-			if(it == it_end){
-				throw std::invalid_argument("[" + stop_name_1 + ", " + stop_name_2 + "] not found");
-			}
-		}
-
-		result += it->second;
+		result += GetRoadDistance(stop_1, stop_2);
 		i++;
 	} while(i < stop_count - 1);
 
@@ -549,35 +1056,22 @@ size_t BusManager::GetDistanceByStops(const Bus& bus, bool forward) const {
 }
 
 double BusManager::GetDistanceByGeo(const Bus& bus) const {
-	double result = 0.0;
-    size_t stop_count =	bus.stops.size();
 	if(bus.stops.size() < 2){
 		return 0.0;
 	}
 
-	const std::vector<Bus::Stop>& stops_for_bus = bus.stops;
-	auto it_end = stops.end();
-
-	for(size_t i = 0; i < stop_count - 1; i++){
-		const Bus::Stop bus_stop_1 = stops_for_bus[i];
-		const Bus::Stop bus_stop_2 = stops_for_bus[i+1];
-
-		const std::string& stop_name_1 = bus_stop_1.stop_name;
-		const std::string& stop_name_2 = bus_stop_2.stop_name;
-
-		auto it1 = stops.find(stop_name_1);
-		if(it1 == it_end){
-			throw std::invalid_argument(stop_name_1 + " not found");
+	//Тригонометрия посчитана при загрузке остановки, здесь только собираем точки подряд
+	std::vector<GeoPoint> points;
+	points.reserve(bus.stops.size());
+	for(const uint32_t stop_id: bus.stops){
+		const Stop& stop = stops[stop_id];
+		if(!stop.declared){
+			throw std::invalid_argument(stop.name + " not found");
 		}
-
-		auto it2 = stops.find(stop_name_2);
-		if(it2 == it_end){
-			throw std::invalid_argument(stop_name_2 + " not found");
-		}
-
-		result += Distance(it1->second.point, it2->second.point).Length();
+		points.push_back(stop.geo);
 	}
 
+	double result = GeoPathLength(points.data(), points.size());
 	if(bus.route_type == RouteType::Line){
 		result *= 2;
 	}
@@ -585,239 +1079,376 @@ double BusManager::GetDistanceByGeo(const Bus& bus) const {
 	return result;
 }
 
-void BusManager::FillEdgesLine(const Bus& bus){
-	assert(bus.route_type == RouteType::Line);
-
-	const std::vector<Bus::Stop>& stops_for_bus = bus.stops;
-	size_t stop_count = stops_for_bus.size();
-
-	auto it_end = stop_distances.end();
-	for(size_t i = 0; i < stop_count-1; ++i ){
-		const Bus::Stop bus_stop_1 = stops_for_bus[i];
-		const Bus::Stop bus_stop_2 = stops_for_bus[i+1];
+//Вершины есть у маршрутов хотя бы из двух остановок, по одной на каждую остановку маршрута
+size_t BusManager::GetVertexCount(const Bus& bus){
+	return bus.stops.size() < 2 ? 0 : bus.stops.size();
+}
 
-		const std::string stop_name_1 = bus_stop_1.stop_name;
-		const size_t stop_id_1 = bus_stop_1.stop_id;
+//Линейный маршрут - поездки в обе стороны, круговой - вперед и ожидание на конечной
+size_t BusManager::GetRideEdgeCount(const Bus& bus){
+	const size_t vertex_count = GetVertexCount(bus);
+	if(vertex_count == 0){
+		return 0;
+	}
+	return bus.route_type == RouteType::Line ? 2 * (vertex_count - 1) : vertex_count;
+}
 
-		const std::string stop_name_2 = bus_stop_2.stop_name;
-		const size_t stop_id_2 = bus_stop_2.stop_id;
+BusManager::Edge* BusManager::FillRideEdges(uint32_t bus_id, Edge* out) const {
+	const Bus& bus = buses[bus_id];
+	const size_t first_vertex = bus_first_vertex[bus_id];
+	const std::vector<uint32_t>& stops_for_bus = bus.stops;
+	const size_t vertex_count = GetVertexCount(bus);
 
-		auto it_stop_1_2 = stop_distances.find({stop_name_1, stop_name_2});
-		auto it_stop_2_1 = stop_distances.find({stop_name_2, stop_name_1});
+	for(size_t i = 0; i + 1 < vertex_count; ++i){
+		const uint32_t stop_1 = stops_for_bus[i];
+		const uint32_t stop_2 = stops_for_bus[i+1];
+		const size_t vertex_1 = first_vertex + i;
+		const size_t vertex_2 = vertex_1 + 1;
 
-		if(it_stop_1_2 == it_end && it_stop_2_1 == it_end){
-			throw std::invalid_argument("FillEdgesLine. distance [" + stop_name_1 + ", " + stop_name_2 + "] not found");
+		*out++ = {vertex_1, vertex_2, GetRoadDistance(stop_1, stop_2) / settings.bus_velocity, RouteItemType::Bus, bus_id};
+		if(bus.route_type == RouteType::Line){
+			*out++ = {vertex_2, vertex_1, GetRoadDistance(stop_2, stop_1) / settings.bus_velocity, RouteItemType::Bus, bus_id};
 		}
+	}
 
-		double distance_1_2 = -1.0;
-		double distance_2_1 = -1.0;
-
-		if(it_stop_1_2 != it_end){
-			distance_1_2 = it_stop_1_2->second / settings.bus_velocity;
-		}
+	//С конечной кругового маршрута на его начало - ожидание того же автобуса
+	if(bus.route_type == RouteType::Round && vertex_count > 0){
+		*out++ = {first_vertex + vertex_count - 1, first_vertex, settings.bus_wait_time, RouteItemType::Wait, bus_id};
+	}
+	return out;
+}
 
-		if(it_stop_2_1 != it_end){
-			distance_2_1 = it_stop_2_1->second / settings.bus_velocity;
-			if(distance_1_2 < 0){
-				distance_1_2 = distance_2_1;
+//Пересадка возможна между любыми вершинами остановки разных маршрутов,
+//а внутри кругового маршрута - между его повторами остановки, кроме конечной:
+//с конечной на свой маршрут ведет ребро ожидания из FillRideEdges
+template <typename Func>
+void BusManager::ForEachTransfer(uint32_t stop_id, Func func) const {
+	auto inner_transfers = [this](const VertexInfo& vertex){
+		const Bus& bus = buses[vertex.bus_id];
+		return bus.route_type == RouteType::Round && vertex.position + 1 < GetVertexCount(bus);
+	};
+
+	for(const Graph::VertexId from: GetStopVertices(stop_id)){
+		for(const Graph::VertexId to: GetStopVertices(stop_id)){
+			if(from == to){
+				continue;
 			}
-		} else {
-			distance_2_1 = distance_1_2;
+			if(vertices[from].bus_id == vertices[to].bus_id
+					&& !(inner_transfers(vertices[from]) && inner_transfers(vertices[to]))){
+				continue;
+			}
+			func(from, to);
 		}
+	}
+}
 
-		assert(distance_1_2 >= 0 && distance_2_1 >= 0);
-
-		size_t vertex_1 = -1;
-		if(auto it = bus_stop_to_vertex.find({bus.name, stop_id_1}); it != bus_stop_to_vertex.end()){
-			vertex_1 = it->second;
-		} else {
-			vertex_1 = last_init_id++;
-		}
+//id вершин маршрута - префиксная сумма числа вершин предыдущих маршрутов
+void BusManager::FillVertices(){
+	const size_t bus_count = buses.size();
 
-		size_t vertex_2 = -1;
-		if(auto it = bus_stop_to_vertex.find({bus.name, stop_id_2}); it != bus_stop_to_vertex.end()){
-			vertex_2 = it->second;
-		} else {
-			vertex_2 = last_init_id++;
+	bus_first_vertex.assign(bus_count + 1, 0);
+	for(uint32_t bus_id = 0; bus_id < bus_count; bus_id++){
+		bus_first_vertex[bus_id + 1] = bus_first_vertex[bus_id] + GetVertexCount(buses[bus_id]);
+	}
+	last_init_id = bus_first_vertex[bus_count];
+
+	vertices.resize(last_init_id);
+	stop_vertex_offsets.assign(stops.size() + 1, 0);
+	for(uint32_t bus_id = 0; bus_id < bus_count; bus_id++){
+		const Bus& bus = buses[bus_id];
+		for(uint32_t position = 0; position < GetVertexCount(bus); position++){
+			vertices[bus_first_vertex[bus_id] + position] = {bus_id, bus.stops[position], position};
+			stop_vertex_offsets[bus.stops[position] + 1]++;
 		}
+	}
+	std::partial_sum(stop_vertex_offsets.begin(), stop_vertex_offsets.end(), stop_vertex_offsets.begin());
 
-		assert(vertex_1 >= 0 && vertex_2 >= 0);
-
-		vertex_to_bus_stop[vertex_1].insert({bus.name, stop_id_1, stop_name_1});
-		vertex_to_bus_stop[vertex_2].insert({bus.name, stop_id_2, stop_name_2});
+	//Внутри остановки вершины по возрастанию id
+	stop_vertex_ids.resize(last_init_id);
+	std::vector<size_t> next(stop_vertex_offsets.begin(), stop_vertex_offsets.end() - 1);
+	for(size_t vertex_id = 0; vertex_id < vertices.size(); vertex_id++){
+		stop_vertex_ids[next[vertices[vertex_id].stop_id]++] = vertex_id;
+	}
+}
 
-		AddEdge({vertex_1, vertex_2, distance_1_2, RouteItemType::Bus});
-		AddEdge({vertex_2, vertex_1, distance_2_1, RouteItemType::Bus});
+//Построение графа по фазам после FillVertices, каждая фаза параллельна:
+//1. ребра поездок каждого маршрута пишутся в свой заранее посчитанный участок вектора ребер;
+//2. так же ребра пересадок каждой остановки по ее вершинам из stop_vertex_ids;
+//3. MergeEdges упорядочивает ребра.
+//Результат не зависит от числа потоков
+void BusManager::FillEdges(){
+	const size_t bus_count = buses.size();
+
+	std::vector<size_t> first_ride_edge(bus_count + 1, 0);
+	for(uint32_t bus_id = 0; bus_id < bus_count; bus_id++){
+		first_ride_edge[bus_id + 1] = first_ride_edge[bus_id] + GetRideEdgeCount(buses[bus_id]);
+	}
 
-		if(auto it = stop_to_bus_vertex.find(stop_name_1); it != stop_to_bus_vertex.end()){
-			for(const BusVertex bus_vertex: it->second){
-				if(bus_vertex.bus_name == bus.name){
-					continue;
-				}
+	const size_t stop_count = stops.size();
+	std::vector<size_t> first_transfer_edge(stop_count + 1, 0);
+	ParallelFor(stop_count, [&](size_t stop_id){
+		size_t count = 0;
+		ForEachTransfer(stop_id, [&count](size_t, size_t){ count++; });
+		first_transfer_edge[stop_id + 1] = count;
+	});
+	std::partial_sum(first_transfer_edge.begin(), first_transfer_edge.end(), first_transfer_edge.begin());
+
+	const size_t ride_edge_count = first_ride_edge[bus_count];
+	edges.resize(ride_edge_count + first_transfer_edge[stop_count]);
+
+	ParallelFor(bus_count, [&](size_t bus_id){
+		FillRideEdges(bus_id, edges.data() + first_ride_edge[bus_id]);
+	});
+
+	ParallelFor(stop_count, [&](size_t stop_id){
+		Edge* out = edges.data() + ride_edge_count + first_transfer_edge[stop_id];
+		ForEachTransfer(stop_id, [this, &out](size_t from, size_t to){
+			*out++ = {from, to, settings.bus_wait_time, RouteItemType::Wait, vertices[to].bus_id};
+		});
+	});
 
-				AddEdge({vertex_1, bus_vertex.vertex_id, settings.bus_wait_time, RouteItemType::Wait});
-				AddEdge({bus_vertex.vertex_id, vertex_1, settings.bus_wait_time, RouteItemType::Wait});
-			}
-		}
+	MergeEdges();
+}
 
-		if(auto it = stop_to_bus_vertex.find(stop_name_2); it != stop_to_bus_vertex.end()){
-			for(const BusVertex bus_vertex: it->second){
-				if(bus_vertex.bus_name == bus.name){
-					continue;
-				}
+//Из повторяющихся ребер (from, to) остается самое легкое
+void BusManager::MergeEdges(){
+	ParallelSort(edges.begin(), edges.end(), std::less<Edge>());
+	edges.erase(std::unique(edges.begin(), edges.end(), [](const Edge& lhs, const Edge& rhs){
+		return lhs.from == rhs.from && lhs.to == rhs.to;
+	}), edges.end());
+}
 
-				AddEdge({vertex_2, bus_vertex.vertex_id, settings.bus_wait_time, RouteItemType::Wait});
-				AddEdge({bus_vertex.vertex_id, vertex_2, settings.bus_wait_time, RouteItemType::Wait});
-			}
+//Порядок по настройке vertex_order; для обходов граф берется неориентированным
+std::vector<Graph::VertexId> BusManager::MakeVertexOrder() const {
+	if(vertex_order == VertexOrder::Hilbert){
+		std::vector<Point> points(vertices.size());
+		for(size_t vertex_id = 0; vertex_id < vertices.size(); vertex_id++){
+			points[vertex_id] = stops[vertices[vertex_id].stop_id].point;
 		}
+		return MakeHilbertOrder(points);
+	}
 
-		stop_to_bus_vertex[stop_name_1].insert({bus.name, vertex_1});
-		stop_to_bus_vertex[stop_name_2].insert({bus.name, vertex_2});
-
-		bus_stop_to_vertex.insert({{bus.name, stop_id_1, stop_name_1}, vertex_1});
-		bus_stop_to_vertex.insert({{bus.name, stop_id_2, stop_name_2}, vertex_2});
+	std::vector<size_t> offsets(vertices.size() + 1, 0);
+	for(const Edge& edge: edges){
+		offsets[edge.from + 1]++;
+		offsets[edge.to + 1]++;
+	}
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+	std::vector<size_t> neighbours(offsets.back());
+	std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+	for(const Edge& edge: edges){
+		neighbours[next[edge.from]++] = edge.to;
+		neighbours[next[edge.to]++] = edge.from;
 	}
-}
 
-void BusManager::FillEdgesRound(const Bus& bus){
-	assert(bus.route_type == RouteType::Round);
+	return vertex_order == VertexOrder::Bfs ? MakeBfsOrder(offsets, neighbours) : MakeRcmOrder(offsets, neighbours);
+}
 
-	const std::vector<Bus::Stop>& stops_for_bus = bus.stops;
-	size_t stop_count = stops_for_bus.size();
+std::vector<Graph::VertexId> BusManager::RenumberVertices(std::vector<Graph::VertexId> order){
+	std::vector<Graph::VertexId> new_ids(order.size());
+	std::vector<VertexInfo> renumbered(order.size());
+	for(Graph::VertexId vertex_id = 0; vertex_id < order.size(); vertex_id++){
+		new_ids[order[vertex_id]] = vertex_id;
+		renumbered[vertex_id] = vertices[order[vertex_id]];
+	}
+	vertices = std::move(renumbered);
 
-	auto it_end = stop_distances.end();
-	for(size_t i = 0; i < stop_count-2; ++i ){
-		const Bus::Stop bus_stop_1 = stops_for_bus[i];
-		const Bus::Stop bus_stop_2 = stops_for_bus[i+1];
+	//Внутри остановки вершины снова по возрастанию id
+	for(Graph::VertexId& vertex_id: stop_vertex_ids){
+		vertex_id = new_ids[vertex_id];
+	}
+	for(uint32_t stop_id = 0; stop_id < stops.size(); stop_id++){
+		std::sort(stop_vertex_ids.begin() + stop_vertex_offsets[stop_id], stop_vertex_ids.begin() + stop_vertex_offsets[stop_id + 1]);
+	}
 
-		const std::string stop_name_1 = bus_stop_1.stop_name;
-		const size_t stop_id_1 = bus_stop_1.stop_id;
+	original_vertex_ids = std::move(order);
+	return new_ids;
+}
 
-		const std::string stop_name_2 = bus_stop_2.stop_name;
-		const size_t stop_id_2 = bus_stop_2.stop_id;
+//Вызывается после FillEdges: ребра переводятся в новую нумерацию и снова упорядочиваются по (from, to)
+void BusManager::ApplyVertexOrder(){
+	if(vertex_order == VertexOrder::Bus){
+		return;
+	}
 
-		auto it_stop_1_2 = stop_distances.find({stop_name_1, stop_name_2});
-		auto it_stop_2_1 = stop_distances.find({stop_name_2, stop_name_1});
+	const std::vector<Graph::VertexId> new_ids = RenumberVertices(MakeVertexOrder());
+	for(Edge& edge: edges){
+		edge.from = new_ids[edge.from];
+		edge.to = new_ids[edge.to];
+	}
+	MergeEdges();
+}
 
-		if(it_stop_1_2 == it_end && it_stop_2_1 == it_end){
-			throw std::invalid_argument("FillEdgesLine. distance [" + stop_name_1 + ", " + stop_name_2 + "] not found");
+//Вызывается в BuildRouter, после любой перенумерации. Обычные ребра между опорными вершинами
+//переходят в граф маршрутизатора как есть, в том же порядке; за ними - ребра-цепочки
+void BusManager::CompressChains(){
+	const size_t vertex_count = vertices.size();
+
+	//Перенумерация, если была: исходный id -> текущий
+	std::vector<Graph::VertexId> current_ids;
+	if(!original_vertex_ids.empty()){
+		current_ids.resize(vertex_count);
+		for(Graph::VertexId vertex_id = 0; vertex_id < vertex_count; vertex_id++){
+			current_ids[original_vertex_ids[vertex_id]] = vertex_id;
 		}
-
-		double distance_1_2 = -1.0;
-
-		if(it_stop_1_2 != it_end){
-			distance_1_2 = it_stop_1_2->second / settings.bus_velocity;
+	}
+	auto vertex_at = [&](uint32_t bus_id, size_t position){
+		const Graph::VertexId original_id = bus_first_vertex[bus_id] + position;
+		return current_ids.empty() ? original_id : current_ids[original_id];
+	};
+
+	//Веса поездок по шагам: от вершины к следующей по маршруту и обратно к ней от следующей
+	std::vector<bool> is_core(vertex_count, false);
+	std::vector<double> forward_weights(vertex_count, 0.0);
+	std::vector<double> backward_weights(vertex_count, 0.0);
+	for(const Edge& edge: edges){
+		if(edge.route_item_type == RouteItemType::Wait){
+			is_core[edge.from] = true;
+			is_core[edge.to] = true;
+		} else if(vertices[edge.to].position > vertices[edge.from].position){
+			forward_weights[edge.from] = edge.distance;
 		} else {
-			distance_1_2 = it_stop_2_1->second / settings.bus_velocity;
+			backward_weights[edge.to] = edge.distance;
 		}
-
-		assert(distance_1_2 >= 0);
-
-		size_t vertex_1 = -1;
-		if(auto it = bus_stop_to_vertex.find({ bus.name, stop_id_1 }); it != bus_stop_to_vertex.end()){
-			vertex_1 = it->second;
-		} else {
-			vertex_1 = last_init_id++;
+	}
+	for(uint32_t bus_id = 0; bus_id < buses.size(); bus_id++){
+		if(const size_t bus_vertex_count = GetVertexCount(buses[bus_id]); bus_vertex_count > 0){
+			is_core[vertex_at(bus_id, 0)] = true;
+			is_core[vertex_at(bus_id, bus_vertex_count - 1)] = true;
 		}
+	}
 
-		size_t vertex_2 = -1;
-		if(auto it = bus_stop_to_vertex.find({ bus.name, stop_id_2 }); it != bus_stop_to_vertex.end()){
-			vertex_2 = it->second;
-		} else {
-			vertex_2 = last_init_id++;
+	vertex_places.assign(vertex_count, {NO_CORE_VERTEX, NO_CHAIN, 0});
+	core_vertices.clear();
+	for(Graph::VertexId vertex_id = 0; vertex_id < vertex_count; vertex_id++){
+		if(is_core[vertex_id]){
+			vertex_places[vertex_id].core_id = core_vertices.size();
+			core_vertices.push_back(vertex_id);
 		}
+	}
 
-		assert(vertex_1 >= 0 && vertex_2 >= 0);
-
-		vertex_to_bus_stop[vertex_1].insert({bus.name, stop_id_1, stop_name_1});
-		vertex_to_bus_stop[vertex_2].insert({bus.name, stop_id_2, stop_name_2});
-
-		AddEdge({vertex_1, vertex_2, distance_1_2, RouteItemType::Bus});
-
-		if(auto it = stop_to_bus_vertex.find(stop_name_1); it != stop_to_bus_vertex.end()){
-			for(const BusVertex bus_vertex: it->second){
-				if(bus_vertex.bus_name == bus.name && vertex_1 == bus_vertex.vertex_id){
-					continue;
-				}
-
-				AddEdge({vertex_1, bus_vertex.vertex_id, settings.bus_wait_time, RouteItemType::Wait});
-				AddEdge({bus_vertex.vertex_id, vertex_1, settings.bus_wait_time, RouteItemType::Wait});
-			}
+	core_edges.clear();
+	core_edge_chains.clear();
+	for(const Edge& edge: edges){
+		if(is_core[edge.from] && is_core[edge.to]){
+			core_edges.push_back({vertex_places[edge.from].core_id, vertex_places[edge.to].core_id,
+					edge.distance, edge.route_item_type, edge.bus_id});
+			core_edge_chains.push_back({NO_CHAIN, false});
 		}
+	}
 
-		if(auto it = stop_to_bus_vertex.find(stop_name_2); it != stop_to_bus_vertex.end()){
-			for(const BusVertex bus_vertex: it->second){
-				if(bus_vertex.bus_name == bus.name && vertex_2 == bus_vertex.vertex_id){
-					continue;
+	chains.clear();
+	chain_weights.clear();
+	chain_times.clear();
+	for(uint32_t bus_id = 0; bus_id < buses.size(); bus_id++){
+		const Bus& bus = buses[bus_id];
+		const size_t bus_vertex_count = GetVertexCount(bus);
+		size_t first = 0;
+		for(size_t last = 1; last < bus_vertex_count; last++){
+			if(!is_core[vertex_at(bus_id, last)]){
+				continue;
+			}
+			if(last - first > 1){
+				const uint32_t chain_id = chains.size();
+				Chain chain{bus_id, vertex_places[vertex_at(bus_id, first)].core_id, vertex_places[vertex_at(bus_id, last)].core_id,
+						static_cast<uint32_t>(last - first), chain_weights.size(), chain_times.size(), bus.route_type == RouteType::Line};
+				double time = 0.0;
+				chain_times.push_back(time);
+				for(size_t position = first; position < last; position++){
+					chain_weights.push_back(forward_weights[vertex_at(bus_id, position)]);
+					time += chain_weights.back();
+					chain_times.push_back(time);
+				}
+				if(chain.two_way){
+					for(size_t position = first; position < last; position++){
+						chain_weights.push_back(backward_weights[vertex_at(bus_id, position)]);
+					}
+					//Обратные суммы копятся от конца цепочки - в том же порядке, что и при проезде
+					const size_t first_backward = chain_times.size();
+					chain_times.resize(first_backward + chain.span_count + 1);
+					time = 0.0;
+					chain_times[first_backward + chain.span_count] = time;
+					for(size_t i = chain.span_count; i > 0; i--){
+						time += chain_weights[chain.first_weight + chain.span_count + i - 1];
+						chain_times[first_backward + i - 1] = time;
+					}
+				}
+				for(size_t position = first + 1; position < last; position++){
+					vertex_places[vertex_at(bus_id, position)] = {NO_CORE_VERTEX, chain_id, static_cast<uint32_t>(position - first)};
 				}
+				chains.push_back(chain);
 
-				AddEdge({vertex_2, bus_vertex.vertex_id, settings.bus_wait_time, RouteItemType::Wait});
-				AddEdge({bus_vertex.vertex_id, vertex_2, settings.bus_wait_time, RouteItemType::Wait});
+				core_edges.push_back({chain.from, chain.to, GetWalkTime({chain_id, 0, chain.span_count}), RouteItemType::Bus, bus_id});
+				core_edge_chains.push_back({chain_id, false});
+				if(chain.two_way){
+					core_edges.push_back({chain.to, chain.from, GetWalkTime({chain_id, chain.span_count, 0}), RouteItemType::Bus, bus_id});
+					core_edge_chains.push_back({chain_id, true});
+				}
 			}
+			first = last;
 		}
-
-		stop_to_bus_vertex[stop_name_1].insert({bus.name, vertex_1});
-		stop_to_bus_vertex[stop_name_2].insert({bus.name, vertex_2});
-
-		bus_stop_to_vertex.insert({{bus.name, stop_id_1, stop_name_1}, vertex_1});
-		bus_stop_to_vertex.insert({{bus.name, stop_id_2, stop_name_2}, vertex_2});
 	}
+}
 
-	//Остановка stops_for_bus.size()-2  -- stops_for_bus.size()-1
-	{
-		const std::string& stop_name_1 = stops_for_bus[stop_count-2].stop_name;
-		const size_t& stop_id_1 = stops_for_bus[stop_count-2].stop_id;
-		const size_t& vertex_1 = bus_stop_to_vertex.at({bus.name, stop_id_1});
-
-		const std::string& stop_name_2 = stops_for_bus[stop_count-1].stop_name;
-		const size_t& stop_id_2 = stops_for_bus[stop_count-1].stop_id;
-		size_t vertex_2 = last_init_id++;
-
-		AddEdge({vertex_1, vertex_2,
-			stop_distances.at({stop_name_1, stop_name_2})/settings.bus_velocity, RouteItemType::Bus});
-
-		vertex_to_bus_stop[vertex_1].insert({bus.name, stop_id_1, stop_name_1});
-		vertex_to_bus_stop[vertex_2].insert({bus.name, stop_id_2, stop_name_2});
+//Компонента вершины полного графа: промежуточная вершина цепочки - в компоненте ее концов
+uint32_t BusManager::GetVertexComponent(Graph::VertexId vertex_id) const {
+	const VertexPlace& place = vertex_places[vertex_id];
+	return core_components[place.core_id != NO_CORE_VERTEX ? place.core_id : chains[place.chain].from];
+}
 
-		stop_to_bus_vertex[stop_name_1].insert({bus.name, vertex_1});
-		stop_to_bus_vertex[stop_name_2].insert({bus.name, vertex_2});
+void BusManager::SplitComponents(){
+	const size_t core_count = core_vertices.size();
 
-		bus_stop_to_vertex.insert({{bus.name, stop_id_1, stop_name_1}, vertex_1});
-		bus_stop_to_vertex.insert({{bus.name, stop_id_2, stop_name_2}, vertex_2});
+	//Система непересекающихся множеств со сжатием путей делением пополам
+	std::vector<Graph::VertexId> parents(core_count);
+	std::iota(parents.begin(), parents.end(), 0);
+	auto find_root = [&parents](Graph::VertexId vertex_id){
+		while(parents[vertex_id] != vertex_id){
+			parents[vertex_id] = parents[parents[vertex_id]];
+			vertex_id = parents[vertex_id];
+		}
+		return vertex_id;
+	};
+	for(const Edge& edge: core_edges){
+		const Graph::VertexId from_root = find_root(edge.from);
+		const Graph::VertexId to_root = find_root(edge.to);
+		if(from_root != to_root){
+			parents[std::max(from_root, to_root)] = std::min(from_root, to_root);
+		}
 	}
 
-	{
-		const std::string& stop_name_1 = stops_for_bus[stop_count-1].stop_name;
-		const size_t& stop_id_1 = stops_for_bus[stop_count-1].stop_id;
-		const size_t& vertex_1 = bus_stop_to_vertex.at({bus.name, stop_id_1});
-
-		const std::string& stop_name_2 = stop_name_1;
-		const size_t& stop_id_2 = stops_for_bus[0].stop_id;
-		size_t vertex_2 = bus_stop_to_vertex.at({bus.name, stop_id_2});
-
-		AddEdge({vertex_1, vertex_2, settings.bus_wait_time, RouteItemType::Wait});
-
-		vertex_to_bus_stop[vertex_1].insert({bus.name, stop_id_1, stop_name_1});
-		vertex_to_bus_stop[vertex_2].insert({bus.name, stop_id_2, stop_name_2});
-
-		stop_to_bus_vertex[stop_name_1].insert({bus.name, vertex_1});
-		stop_to_bus_vertex[stop_name_2].insert({bus.name, vertex_2});
-
-		bus_stop_to_vertex.insert({{bus.name, stop_id_1, stop_name_1}, vertex_1});
-		bus_stop_to_vertex.insert({{bus.name, stop_id_2, stop_name_2}, vertex_2});
+	//Компоненты нумеруются по наименьшей опорной вершине, внутри компоненты порядок вершин и ребер
+	//прежний: маршрутизатор перебирает их в том же порядке, что и общий, и находит те же пути
+	components.clear();
+	core_components.assign(core_count, NO_COMPONENT);
+	core_local_ids.assign(core_count, 0);
+	std::vector<size_t> component_sizes;
+	for(Graph::VertexId core_id = 0; core_id < core_count; core_id++){
+		const Graph::VertexId root = find_root(core_id);
+		if(root == core_id){
+			core_components[core_id] = component_sizes.size();
+			component_sizes.push_back(0);
+		}
+		core_components[core_id] = core_components[root];
+		core_local_ids[core_id] = component_sizes[core_components[core_id]]++;
 	}
-}
 
-void BusManager::AddEdge(const Edge& edge){
-	auto it = edges.find({edge.from, edge.to});
-	if(it == edges.end()){
-		edges.insert({edge.from, edge.to, edge.distance, edge.route_item_type});
-		return;
+	components.resize(component_sizes.size());
+	for(size_t component_id = 0; component_id < components.size(); component_id++){
+		components[component_id].graph = std::make_unique<Graph::DirectedWeightedGraph<double>>(component_sizes[component_id]);
+		components[component_id].router_once = std::make_unique<std::once_flag>();
 	}
-
-	if(it->distance < edge.distance){
-		return;
+	for(size_t core_edge_id = 0; core_edge_id < core_edges.size(); core_edge_id++){
+		const auto& [from, to, distance, route_item_type, bus_id] = core_edges[core_edge_id];
+		RoutingComponent& component = components[core_components[from]];
+		component.graph->AddEdge({core_local_ids[from], core_local_ids[to], distance, route_item_type, bus_id});
+		component.core_edge_ids.push_back(core_edge_id);
 	}
 
-	edges.insert({edge.from, edge.to, edge.distance, edge.route_item_type});
+	stop_components.assign(stops.size(), NO_COMPONENT);
+	for(uint32_t stop_id = 0; stop_id < stops.size(); stop_id++){
+		if(const auto stop_vertices = GetStopVertices(stop_id); stop_vertices.begin() != stop_vertices.end()){
+			stop_components[stop_id] = GetVertexComponent(*stop_vertices.begin());
+		}
+	}
 }
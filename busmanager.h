@@ -2,121 +2,300 @@
 #include <unordered_map>
 #include <map>
 #include <vector>
-#include <set>
 #include <unordered_set>
 #include <sstream>
 #include <string>
 #include <string_view>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <tuple>
 #include <optional>
 #include "bus.h"
 #include "command.h"
+#include "distancetable.h"
 #include "route.h"
 #include "json.h"
+#include "memoryusage.h"
+#include "nameindex.h"
 #include "routing_settings.h"
 #include "graph.h"
 #include "router.h"
+#include "responsewriter.h"
+#include "vertexorder.h"
 
 class BusManager {
 public:
 	BusManager();
+	~BusManager();
 	BusManager& Read(std::istream& in = std::cin);
+	//Только данные и граф, без маршрутизатора: для SaveSnapshot. Запросы Route после нее не поддерживаются
+	BusManager& ReadNetwork(std::istream& in = std::cin);
 	void WriteResponse(std::ostream& out = std::cout) const;
 
-private:
-	size_t last_init_id;
-	bool logging = true;
+	//Потоковый режим: если base_requests и routing_settings идут в документе
+	//раньше stat_requests, ответ на каждый запрос пишется сразу после его разбора
+	void Process(std::istream& in = std::cin, std::ostream& out = std::cout);
 
-	struct BusVertex{
-		std::string bus_name;
-		size_t vertex_id;
+	//Ответ на один запрос в формате stat_requests, после загрузки сети. Сеть при этом не меняется,
+	//так что запросы можно обрабатывать из нескольких потоков одновременно
+	void WriteResponse(const Json::Map& request, ResponseWriter& writer) const;
 
-		bool operator == (const BusVertex& other) const {
-			return bus_name == other.bus_name && vertex_id == other.vertex_id;
-		}
-	};
+	BusManager& SetResponseFormat(ResponseWriter::Format format);
 
-	struct BusVertexHasher {
-		size_t operator() (const BusVertex& bv) const {
-			size_t x = 2'946'901;
-			return shash(bv.bus_name) * x + size_t_hash(bv.vertex_id);
-		}
+	//Перенумерация вершин перед построением маршрутизатора, по умолчанию VertexOrder::Bus - без нее.
+	//Влияет только на раскладку в памяти: ответы те же с точностью до выбора среди равных по времени
+	BusManager& SetVertexOrder(VertexOrder order);
 
-		std::hash<std::string> shash;
-		std::hash<size_t> size_t_hash;
-	};
+	//Двоичный снимок загруженной сети: имена, координаты, маршруты, расстояния и ребра графа.
+	//После LoadSnapshot в Process достаточно подать документ только с stat_requests.
+	//Маршрутизаторы после LoadSnapshot строятся в фоне; запрос Route в еще не готовой компоненте
+	//дожидается ее маршрутизатора или строит его сам
+	void SaveSnapshot(std::ostream& out) const;
+	BusManager& LoadSnapshot(std::istream& in);
 
-	struct BusStop{
-		std::string bus_name;
-		size_t stop_id;
-		std::string stop_name;
+	//Куда уходит память: по каждой структуре число элементов, емкость, байты в куче
+	//и заполненность хеш-таблиц. Одна строка JSON с phase "current"
+	void WriteMemoryReport(std::ostream& out) const;
 
-		bool operator == (const BusStop& other) const {
-			return bus_name == other.bus_name && stop_id == other.stop_id;
-		}
-	};
+	//Тот же отчет после каждой фазы загрузки: base, graph, router, snapshot. nullptr - не писать
+	BusManager& SetMemoryReport(std::ostream* out);
 
-	struct BusStopHasher {
-		size_t operator() (const BusStop& bs) const {
-			size_t x = 2'946'901;
-			return shash(bs.bus_name) * x + size_t_hash(bs.stop_id);
-		}
+private:
+	//Стековый буфер для временных данных разбора одного запроса
+	static const size_t SCRATCH_BUFFER_SIZE = 4096;
+
+	size_t last_init_id;
+	bool logging = false;
+	ResponseWriter::Format response_format = ResponseWriter::Format::Pretty;
+	VertexOrder vertex_order = VertexOrder::Bus;
+	std::ostream* memory_report = nullptr;
+	//Наибольший размер арены потокового разбора base_requests
+	size_t json_arena_size = 0;
 
-		std::hash<std::string> shash;
-		std::hash<size_t> size_t_hash;
+	//Вершина графа - остановка маршрута. Вершины маршрута идут подряд, начиная с bus_first_vertex[bus_id]
+	struct VertexInfo {
+		uint32_t bus_id;
+		uint32_t stop_id;
+		uint32_t position; //Номер остановки в маршруте
 	};
 
-	std::unordered_map<size_t, std::unordered_set<BusStop, BusStopHasher>> vertex_to_bus_stop;
-	std::unordered_map<BusStop, size_t, BusStopHasher> bus_stop_to_vertex;
+	std::vector<VertexInfo> vertices;
+	//В исходной нумерации FillVertices
+	std::vector<size_t> bus_first_vertex;
+	//После перенумерации: original_vertex_ids[vertex_id] - id вершины в исходной нумерации; пуст без нее
+	std::vector<Graph::VertexId> original_vertex_ids;
 
-	std::unordered_map<std::string, std::unordered_set<BusVertex, BusVertexHasher>> stop_to_bus_vertex;
+	//Вершины остановки подряд: stop_vertex_ids[stop_vertex_offsets[stop_id]..stop_vertex_offsets[stop_id + 1])
+	std::vector<size_t> stop_vertex_offsets;
+	std::vector<Graph::VertexId> stop_vertex_ids;
 
 	struct Edge {
 	    size_t from;
 	    size_t to;
 	    double distance;
 	    RouteItemType route_item_type;
+	    uint32_t bus_id; //Для ребер поездки
 
-	    bool operator == (const Edge& other) const {
-			return from == other.from && to == other.to;
+	    bool operator < (const Edge& other) const {
+			return std::tie(from, to, distance, route_item_type, bus_id)
+					< std::tie(other.from, other.to, other.distance, other.route_item_type, other.bus_id);
 		}
 	  };
 
-	struct EdgeHasher {
-		size_t operator() (const Edge& e) const {
-			size_t x = 2'946'901;
-			return shash(e.from) * x + shash(e.to);
-		}
+	//Ребра пишутся FillEdges в заранее посчитанные участки, повторы убирает MergeEdges.
+	//После него ребра упорядочены по (from, to)
+	std::vector<Edge> edges;
+
+	//Сжатие цепочек. Опорные вершины - конечные маршрутов и вершины с пересадками; остальные
+	//(промежуточные остановки одного маршрута) ветвлением быть не могут. Маршрутизатор строится
+	//только по опорным вершинам, а поездка между соседними опорными вершинами маршрута через
+	//промежуточные - одно ребро-цепочка. Веса шагов цепочки хранятся для восстановления ответа
+	static const uint32_t NO_CHAIN = ~uint32_t(0);
+	static const Graph::VertexId NO_CORE_VERTEX = ~Graph::VertexId(0);
+
+	struct Chain {
+		uint32_t bus_id;
+		Graph::VertexId from; //Опорные вершины на концах, в нумерации графа маршрутизатора
+		Graph::VertexId to;
+		uint32_t span_count;
+		//Шаг i - между вершинами цепочки i и i + 1: вперед - chain_weights[first_weight + i],
+		//обратно (только у линейных маршрутов) - chain_weights[first_weight + span_count + i]
+		size_t first_weight;
+		//Накопленные времена, span_count + 1 значений на направление: вперед - chain_times[first_time + k],
+		//сумма шагов до вершины k; обратно - chain_times[first_time + span_count + 1 + k], сумма шагов от вершины k до конца
+		size_t first_time;
+		bool two_way;
+	};
+
+	//Место вершины полного графа: id опорной вершины или цепочка и номер в ней (от 1 до span_count - 1)
+	struct VertexPlace {
+		Graph::VertexId core_id;
+		uint32_t chain;
+		uint32_t offset;
+	};
 
-		std::hash<std::size_t> shash;
+	//Для ребра графа маршрутизатора: цепочка и направление, NO_CHAIN - обычное ребро
+	struct CoreEdgeChain {
+		uint32_t chain;
+		bool backward;
 	};
 
-	std::unordered_set<Edge, EdgeHasher> edges;
+	std::vector<Chain> chains;
+	std::vector<double> chain_weights;
+	std::vector<double> chain_times;
+	std::vector<VertexPlace> vertex_places;
+	std::vector<Graph::VertexId> core_vertices; //id опорной вершины -> вершина полного графа
+	std::vector<Edge> core_edges;
+	std::vector<CoreEdgeChain> core_edge_chains;
+
+	//Компоненты связности графа опорных вершин (без учета направления ребер). У каждой свой граф
+	//и маршрутизатор с локальными id вершин и ребер: таблица всех пар занимает сумму квадратов
+	//размеров компонент, а не квадрат их суммы. Пути между компонентами нет, его не ищем
+	static constexpr uint32_t NO_COMPONENT = ~uint32_t(0);
+
+	struct RoutingComponent {
+		std::vector<size_t> core_edge_ids; //Локальный id ребра -> индекс в core_edges
+		std::unique_ptr<Graph::DirectedWeightedGraph<double>> graph;
+		//Строится один раз через GetComponentRouter, из любого потока
+		std::unique_ptr<std::once_flag> router_once;
+		mutable std::unique_ptr<Graph::Router<double>> router;
+	};
+
+	std::vector<RoutingComponent> components;
+	//По id опорной вершины: компонента и id вершины в ее графе
+	std::vector<uint32_t> core_components;
+	std::vector<Graph::VertexId> core_local_ids;
+	//По id остановки. Вершины остановки связаны пересадками и поездками, компонента у них общая;
+	//NO_COMPONENT - через остановку не проходит ни один маршрут
+	std::vector<uint32_t> stop_components;
+	bool graph_built = false;
+	bool routes_built = false;
+	//Фоновое построение маршрутизаторов после LoadSnapshot, ждем его в деструкторе
+	std::thread router_builder;
 
 	RoutingSettings settings;
-	std::unordered_map<std::string, Bus> buses;
-	std::unordered_map<std::string, Stop> stops;
-	std::unordered_map<std::string, std::set<std::string>> stop_to_buses;
-	std::unordered_map<StopPair, size_t, StopPairHasher> stop_distances;
+
+	//Имена переводятся в плотные id один раз при загрузке, дальше всё индексируется по id.
+	//Строки нужны только на границе с JSON: в запросах и в ответах
+	//Узлы словарей имен живут до конца работы: берем их из пула, а не отдельными new
+	std::pmr::unsynchronized_pool_resource name_pool;
+	std::pmr::unordered_map<std::string, uint32_t> stop_ids;
+	std::pmr::unordered_map<std::string, uint32_t> bus_ids;
+	//Те же словари для запросов, строятся в конце загрузки
+	NameIndex stop_index;
+	NameIndex bus_index;
+	std::vector<Stop> stops;
+	std::vector<Bus> buses;
+	//По id остановки - id проходящих через нее маршрутов в порядке имен
+	std::vector<std::vector<uint32_t>> stop_to_buses;
+	//Ответ на запрос Stop после загрузки не меняется: массив имен маршрутов остановки сериализован
+	//заранее для каждого формата ответа. Массив остановки - json[offsets[stop_id]..offsets[stop_id + 1]).
+	//Отступы Pretty верны только на глубине depth, Compact годится на любой
+	struct StopFragments {
+		std::string json;
+		std::vector<size_t> offsets;
+		size_t depth = 0;
+	};
+	StopFragments stop_fragments[2];
+	//Обратные направления достраиваются после загрузки
+	DistanceTable stop_distances;
+	//По id маршрута
+	std::vector<BusStats> bus_stats;
 
 	std::vector<std::unique_ptr<Command>> commands;
 
+	uint32_t InternStop(std::string_view name);
+
+	uint64_t GetRoadDistance(uint32_t stop_from, uint32_t stop_to) const;
 	double GetDistanceByGeo(const Bus& bus) const;
 	size_t GetDistanceByStops(const Bus& bus) const;
 	size_t GetDistanceByStops(const Bus& bus, bool forward) const;
 
-	BusManager& ReadData(const std::vector<Json::Node>& node);
-	BusManager& ReadRequest(const std::vector<Json::Node>& node);
-	BusManager& ReadSettings(const std::map<std::string, Json::Node>& node);
+	BusManager& ReadData(const Json::Map& node_map);
+	std::unique_ptr<Command> ReadRequest(const Json::Map& node_map) const;
+	BusManager& ReadSettings(const Json::Map& node);
+
+	//Проезд по цепочке от вершины offset_from до offset_to; при offset_to < offset_from - обратно
+	struct ChainWalk {
+		uint32_t chain = NO_CHAIN;
+		uint32_t offset_from = 0;
+		uint32_t offset_to = 0;
+	};
+
+	//Путь от вершины полного графа до опорной (или обратно) и его время
+	struct CoreLink {
+		Graph::VertexId core_id;
+		double time;
+		ChainWalk walk;
+	};
+
+	//Одно ребро полного графа в найденном маршруте
+	struct RouteStep {
+		RouteItemType route_item_type;
+		uint32_t bus_id;
+		uint32_t stop_id; //Для ожидания
+		double time;
+	};
+
+	double GetWalkTime(const ChainWalk& walk) const;
+	void AppendWalkSteps(const ChainWalk& walk, std::vector<RouteStep>& steps) const;
+	//Не больше двух: у внутренней вершины линейного маршрута - к обоим концам цепочки
+	struct CoreLinks {
+		CoreLink links[2];
+		size_t count;
+	};
+	CoreLinks GetCoreExits(Graph::VertexId vertex_id) const;
+	CoreLinks GetCoreEntries(Graph::VertexId vertex_id) const;
+	std::optional<ChainWalk> GetDirectWalk(Graph::VertexId from, Graph::VertexId to) const;
+
+	uint32_t GetVertexComponent(Graph::VertexId vertex_id) const;
+	Graph::Router<double>& GetComponentRouter(const RoutingComponent& component) const;
+	//Буферы ответа на Route: в установившемся режиме маршрут строится без выделений памяти
+	struct RouteBuffers {
+		Route route;
+		std::vector<RouteStep> steps;
+		std::vector<Graph::EdgeId> edges;
+		std::vector<CoreLinks> exits; //По вершинам остановки отправления
+		std::vector<CoreLinks> entries; //По вершинам остановки прибытия
+	};
+	static RouteBuffers& GetRouteBuffers();
+	//Результат - в buffers.route; пустой items - маршрута нет
+	void BuildBestRoute(const RouteCommand& command, RouteBuffers& buffers) const;
+	void WriteRouteItem(const RouteItemWait& item, ResponseWriter& writer) const;
+	void WriteRouteItem(const RouteItemBus& item, ResponseWriter& writer) const;
+
+	void ReadDocument(std::istream& in, ResponseWriter* writer, bool build_router = true);
+	void WriteResponse(const Command& command, ResponseWriter& writer) const;
 
-	Route BuildBestRoute(const RouteCommand& command,
-		const Graph::DirectedWeightedGraph<double>& graph,
-		Graph::Router<double>& router) const;
+	void BuildRoutes();
+	void BuildGraph();
+	//background - маршрутизаторы компонент строятся в отдельном потоке, BuildRouter их не ждет
+	void BuildRouter(bool background = false);
+	void BuildNameIndexes();
+	void FillStopBuses();
+	void FillStopFragments();
+	void FillBusStats();
 
-	void FillEdgesLine(const Bus& bus);
-	void FillEdgesRound(const Bus& bus);
+	static size_t GetVertexCount(const Bus& bus);
+	static size_t GetRideEdgeCount(const Bus& bus);
+	Edge* FillRideEdges(uint32_t bus_id, Edge* out) const;
+	template <typename Func>
+	void ForEachTransfer(uint32_t stop_id, Func func) const;
+	void FillVertices();
+	void FillEdges();
+	std::vector<Graph::VertexId> MakeVertexOrder() const;
+	//order[new_id] = old_id; переставляет метаданные вершин и возвращает old_id -> new_id
+	std::vector<Graph::VertexId> RenumberVertices(std::vector<Graph::VertexId> order);
+	void ApplyVertexOrder();
+	void CompressChains();
+	void SplitComponents();
+	Range<const Graph::VertexId*> GetStopVertices(uint32_t stop_id) const;
+	void MergeEdges();
 
-	double GetDistance(std::vector<std::string>::const_iterator it) const;
-	void AddEdge(const Edge& edge);
+	std::vector<MemoryUsageEntry> CollectMemoryUsage() const;
+	void WriteMemoryReport(std::ostream& out, std::string_view phase) const;
+	void ReportMemory(std::string_view phase) const;
 
 };
@@ -0,0 +1,77 @@
+#include "client.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "socketbuffer.h"
+
+namespace {
+
+//Задержка, не превышенная долей share запросов
+double GetPercentile(const std::vector<double>& sorted_latencies, double share){
+	const size_t index = std::min(sorted_latencies.size() - 1, static_cast<size_t>(share * sorted_latencies.size()));
+	return sorted_latencies[index];
+}
+
+}
+
+int RunClient(const std::string& socket_path, std::istream& in, std::ostream& out, std::ostream& log){
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if(socket_path.size() >= sizeof(address.sun_path)){
+		log << "Слишком длинный путь сокета " << socket_path << '\n';
+		return 1;
+	}
+	std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0){
+		log << "Не удалось подключиться к " << socket_path << ": " << std::strerror(errno) << '\n';
+		if(fd >= 0){
+			close(fd);
+		}
+		return 1;
+	}
+
+	SocketBuffer buffer(fd);
+	std::istream server_in(&buffer);
+	std::ostream server_out(&buffer);
+
+	std::vector<double> latencies;
+	std::string request;
+	std::string response;
+	while(std::getline(in, request)){
+		if(request.find_first_not_of(" \t\r") == std::string::npos){
+			continue;
+		}
+		//Запрос уходит одной записью вместе с переводом строки
+		request += '\n';
+
+		const auto start = std::chrono::steady_clock::now();
+		server_out.write(request.data(), request.size());
+		if(!server_out || !std::getline(server_in, response)){
+			log << "Сервер закрыл соединение\n";
+			return 1;
+		}
+		latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+		out << response << '\n';
+	}
+	out.flush();
+
+	log << "requests - " << latencies.size();
+	if(!latencies.empty()){
+		std::sort(latencies.begin(), latencies.end());
+		log << "; latency, us: mean " << std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size()
+				<< ", p50 " << GetPercentile(latencies, 0.5)
+				<< ", p99 " << GetPercentile(latencies, 0.99)
+				<< ", max " << latencies.back();
+	}
+	log << '\n';
+	return 0;
+}
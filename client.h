@@ -0,0 +1,10 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+//Клиент сервера на Unix domain socket: program --client <socket>.
+//Строки запросов из in отправляются по одной, ответ на каждую печатается в out.
+//В конце в log - число запросов и задержки от отправки до ответа в микросекундах.
+//Возвращает код завершения процесса
+int RunClient(const std::string& socket_path, std::istream& in = std::cin, std::ostream& out = std::cout,
+		std::ostream& log = std::cerr);
@@ -1,6 +1,10 @@
 #include <cmath>
 #include "distance.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 Distance::Distance(const Point& lhs_, const Point& rhs_): lhs(lhs_), rhs(rhs_), length(Calculate()) {
 	}
 
@@ -36,3 +40,122 @@ const double Distance::Calculate() const {
 }
 
 
+
+GeoPoint::GeoPoint(const Point& point)
+	: latitude(point.latitude * RAD_IN_GRAD),
+	  longitude(point.longitude * RAD_IN_GRAD),
+	  sin_latitude(sin(latitude)),
+	  cos_latitude(cos(latitude)),
+	  sin_longitude(sin(longitude)),
+	  cos_longitude(cos(longitude)) {
+}
+
+namespace {
+
+double SegmentLength(const GeoPoint& lhs, const GeoPoint& rhs){
+	//cos и sin разницы долгот
+	const double cdelta = rhs.cos_longitude * lhs.cos_longitude + rhs.sin_longitude * lhs.sin_longitude;
+	const double sdelta = rhs.sin_longitude * lhs.cos_longitude - rhs.cos_longitude * lhs.sin_longitude;
+
+	const double a = rhs.cos_latitude * sdelta;
+	const double b = lhs.cos_latitude * rhs.sin_latitude - lhs.sin_latitude * rhs.cos_latitude * cdelta;
+	const double y = sqrt(a * a + b * b);
+	const double x = lhs.sin_latitude * rhs.sin_latitude + lhs.cos_latitude * rhs.cos_latitude * cdelta;
+	return atan2(y, x) * RADIUS;
+}
+
+#if defined(__AVX2__)
+//atan на [0, 1]: для a > 0.66 через pi/4 + atan((a-1)/(a+1)), дальше рациональная аппроксимация Cephes
+__m256d Atan01(__m256d a){
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d big = _mm256_cmp_pd(a, _mm256_set1_pd(0.66), _CMP_GT_OQ);
+	const __m256d reduced = _mm256_blendv_pd(a, _mm256_div_pd(_mm256_sub_pd(a, one), _mm256_add_pd(a, one)), big);
+	const __m256d base = _mm256_and_pd(big, _mm256_set1_pd(0.78539816339744830962 + 0.5 * 6.123233995736765886130E-17));
+
+	const __m256d z = _mm256_mul_pd(reduced, reduced);
+	auto step = [&z](__m256d value, double coefficient){
+		return _mm256_add_pd(_mm256_mul_pd(value, z), _mm256_set1_pd(coefficient));
+	};
+	__m256d p = _mm256_set1_pd(-8.750608600031904122785E-1);
+	p = step(p, -1.615753718733365076637E1);
+	p = step(p, -7.500855792314704667340E1);
+	p = step(p, -1.228866684490136173410E2);
+	p = step(p, -6.485021904942025371773E1);
+	__m256d q = _mm256_add_pd(z, _mm256_set1_pd(2.485846490142306297962E1));
+	q = step(q, 1.650270098316988542046E2);
+	q = step(q, 4.328810604912902668951E2);
+	q = step(q, 4.853903996359136964868E2);
+	q = step(q, 1.945506571482613964425E2);
+
+	const __m256d r = _mm256_mul_pd(_mm256_mul_pd(reduced, z), _mm256_div_pd(p, q));
+	return _mm256_add_pd(base, _mm256_add_pd(reduced, r));
+}
+
+//atan2 при y >= 0
+__m256d Atan2(__m256d y, __m256d x){
+	const __m256d abs_x = _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+	const __m256d num = _mm256_min_pd(y, abs_x);
+	const __m256d den = _mm256_max_pd(y, abs_x);
+	//0/0 при совпадающих точках дает 0
+	const __m256d zero_den = _mm256_cmp_pd(den, _mm256_setzero_pd(), _CMP_EQ_OQ);
+	const __m256d ratio = _mm256_andnot_pd(zero_den, _mm256_div_pd(num, _mm256_blendv_pd(den, _mm256_set1_pd(1.0), zero_den)));
+
+	__m256d result = Atan01(ratio);
+	result = _mm256_blendv_pd(result, _mm256_sub_pd(_mm256_set1_pd(1.57079632679489661923), result),
+			_mm256_cmp_pd(y, abs_x, _CMP_GT_OQ));
+	result = _mm256_blendv_pd(result, _mm256_sub_pd(_mm256_set1_pd(3.14159265358979323846), result),
+			_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ));
+	return result;
+}
+#endif
+
+}
+
+double GeoPathLengthScalar(const GeoPoint* points, size_t count){
+	double result = 0.0;
+	for(size_t i = 0; i + 1 < count; i++){
+		result += SegmentLength(points[i], points[i + 1]);
+	}
+	return result;
+}
+
+double GeoPathLength(const GeoPoint* points, size_t count){
+#if defined(__AVX2__)
+	if(count < 2){
+		return 0.0;
+	}
+
+	__m256d sum = _mm256_setzero_pd();
+	size_t i = 0;
+	for(; i + 4 < count; i += 4){
+		const GeoPoint* p = points + i;
+		auto field = [p](size_t offset, double GeoPoint::* member){
+			return _mm256_set_pd(p[offset + 3].*member, p[offset + 2].*member, p[offset + 1].*member, p[offset].*member);
+		};
+		const __m256d sl1 = field(0, &GeoPoint::sin_latitude);
+		const __m256d cl1 = field(0, &GeoPoint::cos_latitude);
+		const __m256d sg1 = field(0, &GeoPoint::sin_longitude);
+		const __m256d cg1 = field(0, &GeoPoint::cos_longitude);
+		const __m256d sl2 = field(1, &GeoPoint::sin_latitude);
+		const __m256d cl2 = field(1, &GeoPoint::cos_latitude);
+		const __m256d sg2 = field(1, &GeoPoint::sin_longitude);
+		const __m256d cg2 = field(1, &GeoPoint::cos_longitude);
+
+		const __m256d cdelta = _mm256_add_pd(_mm256_mul_pd(cg2, cg1), _mm256_mul_pd(sg2, sg1));
+		const __m256d sdelta = _mm256_sub_pd(_mm256_mul_pd(sg2, cg1), _mm256_mul_pd(cg2, sg1));
+
+		const __m256d a = _mm256_mul_pd(cl2, sdelta);
+		const __m256d b = _mm256_sub_pd(_mm256_mul_pd(cl1, sl2), _mm256_mul_pd(_mm256_mul_pd(sl1, cl2), cdelta));
+		const __m256d y = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b)));
+		const __m256d x = _mm256_add_pd(_mm256_mul_pd(sl1, sl2), _mm256_mul_pd(_mm256_mul_pd(cl1, cl2), cdelta));
+
+		sum = _mm256_add_pd(sum, Atan2(y, x));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	return (lanes[0] + lanes[1] + lanes[2] + lanes[3]) * RADIUS + GeoPathLengthScalar(points + i, count - i);
+#else
+	return GeoPathLengthScalar(points, count);
+#endif
+}
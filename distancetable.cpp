@@ -0,0 +1,118 @@
+#include "distancetable.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+//Финальное перемешивание splitmix64: соседние id дают далекие группы
+uint64_t Mix(uint64_t key){
+	key ^= key >> 30;
+	key *= 0xBF58476D1CE4E5B9;
+	key ^= key >> 27;
+	key *= 0x94D049BB133111EB;
+	key ^= key >> 31;
+	return key;
+}
+
+}
+
+size_t DistanceTable::GroupFor(uint64_t key) const {
+	const size_t group_count = keys.size() / GROUP_SIZE;
+	return Mix(key) & (group_count - 1);
+}
+
+size_t DistanceTable::FindSlot(uint64_t key) const {
+	const size_t group_mask = keys.size() / GROUP_SIZE - 1;
+	for(size_t group = GroupFor(key); ; group = (group + 1) & group_mask){
+		const uint64_t* group_keys = keys.data() + group * GROUP_SIZE;
+#if defined(__AVX2__)
+		const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group_keys));
+		const int match = _mm256_movemask_pd(_mm256_castsi256_pd(
+				_mm256_cmpeq_epi64(chunk, _mm256_set1_epi64x(static_cast<long long>(key)))));
+		if(match != 0){
+			return group * GROUP_SIZE + __builtin_ctz(match);
+		}
+		const int empty = _mm256_movemask_pd(_mm256_castsi256_pd(
+				_mm256_cmpeq_epi64(chunk, _mm256_set1_epi64x(static_cast<long long>(EMPTY_KEY)))));
+		if(empty != 0){
+			return group * GROUP_SIZE + __builtin_ctz(empty);
+		}
+#else
+		for(size_t i = 0; i < GROUP_SIZE; i++){
+			if(group_keys[i] == key || group_keys[i] == EMPTY_KEY){
+				return group * GROUP_SIZE + i;
+			}
+		}
+#endif
+	}
+}
+
+void DistanceTable::Rehash(size_t new_capacity){
+	std::vector<uint64_t> old_keys = std::move(keys);
+	std::vector<uint64_t> old_values = std::move(values);
+
+	keys.assign(new_capacity, EMPTY_KEY);
+	values.assign(new_capacity, 0);
+	for(size_t i = 0; i < old_keys.size(); i++){
+		if(old_keys[i] != EMPTY_KEY){
+			const size_t slot = FindSlot(old_keys[i]);
+			keys[slot] = old_keys[i];
+			values[slot] = old_values[i];
+		}
+	}
+}
+
+void DistanceTable::Reserve(size_t count){
+	size_t capacity = GROUP_SIZE * 2;
+	while(capacity * 3 < count * 4){
+		capacity *= 2;
+	}
+	if(capacity > keys.size()){
+		Rehash(capacity);
+	}
+}
+
+bool DistanceTable::Insert(uint32_t from, uint32_t to, uint64_t distance){
+	if((size + 1) * 4 > keys.size() * 3){
+		Rehash(keys.empty() ? GROUP_SIZE * 2 : keys.size() * 2);
+	}
+
+	const uint64_t key = MakeKey(from, to);
+	const size_t slot = FindSlot(key);
+	if(keys[slot] == key){
+		return false;
+	}
+
+	keys[slot] = key;
+	values[slot] = distance;
+	size++;
+	return true;
+}
+
+void DistanceTable::AddReverseDirections(){
+	std::vector<std::pair<uint64_t, uint64_t>> reverse;
+	ForEach([&](uint32_t from, uint32_t to, uint64_t distance){
+		if(!Find(to, from)){
+			reverse.emplace_back(MakeKey(to, from), distance);
+		}
+	});
+
+	for(const auto& [key, distance]: reverse){
+		Insert(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key), distance);
+	}
+}
+
+std::optional<uint64_t> DistanceTable::Find(uint32_t from, uint32_t to) const {
+	if(keys.empty()){
+		return std::nullopt;
+	}
+
+	const uint64_t key = MakeKey(from, to);
+	const size_t slot = FindSlot(key);
+	if(keys[slot] != key){
+		return std::nullopt;
+	}
+	return values[slot];
+}
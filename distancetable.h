@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//Расстояния по дорогам между остановками: открытая адресация, ключ - пара id остановок в одном uint64_t.
+//Ячейки сгруппированы по GROUP_SIZE ключей; группа сравнивается с ключом одной AVX2-инструкцией,
+//пробирование идет по группам подряд. Заполненность не выше 3/4.
+class DistanceTable {
+public:
+	//Как emplace: уже заданное расстояние не перезаписывается
+	bool Insert(uint32_t from, uint32_t to, uint64_t distance);
+
+	//Расстояние, заданное только в одну сторону, считается одинаковым в обе стороны.
+	//Вызывается один раз после загрузки, дальше каждый отрезок - один поиск
+	void AddReverseDirections();
+
+	std::optional<uint64_t> Find(uint32_t from, uint32_t to) const;
+
+	size_t Size() const {
+		return size;
+	}
+
+	size_t Capacity() const {
+		return keys.size();
+	}
+
+	size_t MemoryUsage() const {
+		return keys.capacity() * sizeof(uint64_t) + values.capacity() * sizeof(uint64_t);
+	}
+
+	//func(from, to, distance) для всех заданных пар
+	template <typename Func>
+	void ForEach(Func func) const {
+		for(size_t i = 0; i < keys.size(); i++){
+			if(keys[i] != EMPTY_KEY){
+				func(static_cast<uint32_t>(keys[i] >> 32), static_cast<uint32_t>(keys[i]), values[i]);
+			}
+		}
+	}
+
+	void Reserve(size_t count);
+
+private:
+	static constexpr size_t GROUP_SIZE = 4;
+	static constexpr uint64_t EMPTY_KEY = ~uint64_t(0);
+
+	std::vector<uint64_t> keys;
+	std::vector<uint64_t> values;
+	size_t size = 0;
+
+	static uint64_t MakeKey(uint32_t from, uint32_t to) {
+		return (static_cast<uint64_t>(from) << 32) | to;
+	}
+
+	//Первая группа для ключа
+	size_t GroupFor(uint64_t key) const;
+
+	//Ячейка с ключом или первая свободная на пути пробирования
+	size_t FindSlot(uint64_t key) const;
+
+	void Rehash(size_t new_capacity);
+};
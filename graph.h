@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdlib>
 #include <deque>
 #include <vector>
@@ -29,6 +30,7 @@ namespace Graph {
     VertexId to;
     Weight weight;
     RouteItemType route_item_type;
+    uint32_t bus_id;  // для ребер поездки
   };
 
   template <typename Weight>
@@ -46,6 +48,9 @@ namespace Graph {
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    // Байты в куче: ребра и списки смежности
+    size_t GetMemoryUsage() const;
+
   private:
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
@@ -84,4 +89,13 @@ namespace Graph {
     const auto& edges = incidence_lists_[vertex];
     return {std::begin(edges), std::end(edges)};
   }
+
+  template <typename Weight>
+  size_t DirectedWeightedGraph<Weight>::GetMemoryUsage() const {
+    size_t result = edges_.capacity() * sizeof(Edge<Weight>) + incidence_lists_.capacity() * sizeof(IncidenceList);
+    for (const auto& incidence_list : incidence_lists_) {
+      result += incidence_list.capacity() * sizeof(EdgeId);
+    }
+    return result;
+  }
 }
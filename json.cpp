@@ -1,152 +1,356 @@
 #include "json.h"
+#include "jsonscanner.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
 
 using namespace std;
 
 namespace Json {
 
-  Document::Document(Node root) : root(move(root)) {
+  const KeyValue* Map::find(string_view key) const {
+    return find_if(begin(), end(), [key](const KeyValue& item) {
+      return item.first == key;
+    });
+  }
+
+  void Node::Check(Type expected) const {
+    if (type != expected) {
+      throw invalid_argument("Json::Node: unexpected node type");
+    }
+  }
+
+  Document::Document(unique_ptr<pmr::monotonic_buffer_resource> arena, Node root)
+    : arena(move(arena)), root(root) {
   }
 
   const Node& Document::GetRoot() const {
     return root;
   }
 
-  Node LoadNode(istream& input);
+  // Вторая стадия разбора: узлы строятся по индексу структурных символов,
+  // а не по байтам входа. Вход читается кусками chunk_size; в буфере остается
+  // только текущий кусок и недочитанная лексема с предыдущего.
+  // Дочерние узлы копятся на общем стеке и переносятся в арену одним блоком,
+  // когда известен размер контейнера
+  class Loader {
+  public:
+    explicit Loader(istream& input, size_t chunk_size = DEFAULT_CHUNK_SIZE)
+      : input(input), chunk_size(chunk_size), index(make_unique<uint32_t[]>(chunk_size)) {
+    }
+
+    Node Load(pmr::memory_resource& arena_) {
+      arena = &arena_;
+      return LoadNode();
+    }
+
+    char PeekChar();
+    void Skip();
+    void Expect(char expected);
+    string ReadString();
+    // Во входе не осталось ничего, кроме пробелов
+    bool AtEnd();
 
-  Node LoadArray(istream& input) {
-    vector<Node> result;
+  private:
+    static const size_t DEFAULT_CHUNK_SIZE = 1 << 20;
 
-    for (char c; input >> c && c != ']'; ) {
-      if (c != ',') {
-        input.putback(c);
+    istream& input;
+    size_t chunk_size;
+    string buffer;
+    unique_ptr<uint32_t[]> index;
+    size_t index_size = 0;
+    size_t next = 0;
+    ScanState scan_state;
+
+    pmr::memory_resource* arena = nullptr;
+    vector<Node> items_stack;
+    vector<KeyValue> members_stack;
+
+    template <typename T>
+    const T* MoveToArena(vector<T>& stack, size_t first) {
+      const size_t count = stack.size() - first;
+      if (count == 0) {
+        return nullptr;
       }
-      result.push_back(LoadNode(input));
+      T* result = static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+      uninitialized_copy(stack.begin() + first, stack.end(), result);
+      stack.resize(first);
+      return result;
     }
 
-    return Node(move(result));
+    bool Refill(size_t& keep_from);
+    size_t PeekPosition(size_t& keep_from);
+    size_t NextStringEnd(size_t& string_begin);
+
+    Node LoadNode();
+    Node LoadArray();
+    Node LoadDict();
+    Node LoadScalar(size_t begin);
+    string_view LoadString(size_t begin);
+  };
+
+  // Байты до keep_from больше не нужны; keep_from сдвигается вместе с буфером
+  bool Loader::Refill(size_t& keep_from) {
+    if (!input) {
+      return false;
+    }
+
+    buffer.erase(0, keep_from);
+    keep_from = 0;
+    index_size = 0;
+    next = 0;
+
+    const size_t old_size = buffer.size();
+    buffer.resize(old_size + chunk_size);
+    input.read(buffer.data() + old_size, chunk_size);
+    const size_t read_count = input.gcount();
+    buffer.resize(old_size + read_count);
+
+    index_size = ScanStructurals(buffer.data() + old_size, read_count, static_cast<uint32_t>(old_size), scan_state, index.get());
+    return read_count > 0;
   }
 
-  Node LoadBool(istream& input, char c){
-	  std::string bool_string;
-	  bool_string += c;
-	  if(c == 't'){
-		  for(int i = 0; i < 3; i++){
-			  bool_string += input.get();
-		  }
+  size_t Loader::PeekPosition(size_t& keep_from) {
+    while (next == index_size) {
+      if (!Refill(keep_from)) {
+        return string::npos;
+      }
+    }
+    return index[next];
+  }
 
-		  if(bool_string == "true"){
-			  return Node(BoolValue(true));
-		  }
+  char Loader::PeekChar() {
+    size_t keep_from = buffer.size();
+    const size_t position = PeekPosition(keep_from);
+    if (position == string::npos) {
+      throw invalid_argument("Json: unexpected end of input");
+    }
+    return buffer[position];
+  }
 
-		  throw invalid_argument("Wait true, get " + bool_string);
-	  }
+  bool Loader::AtEnd() {
+    size_t keep_from = buffer.size();
+    return PeekPosition(keep_from) == string::npos;
+  }
 
-	  for(int i = 0; i < 4; i++){
-		  bool_string += input.get();
-	  }
+  void Loader::Skip() {
+    ++next;
+  }
+
+  void Loader::Expect(char expected) {
+    if (PeekChar() != expected) {
+      throw invalid_argument(string("Json: expected ") + expected);
+    }
+    Skip();
+  }
 
-	  if(bool_string == "false"){
-		  return Node(BoolValue(false));
-	  }
+  // Закрывающая кавычка - следующая позиция индекса
+  size_t Loader::NextStringEnd(size_t& string_begin) {
+    const size_t string_end = PeekPosition(string_begin);
+    if (string_end == string::npos || buffer[string_end] != '"') {
+      throw invalid_argument("Json: unterminated string");
+    }
+    Skip();
+    return string_end;
+  }
 
-	  throw invalid_argument("Wait false, get " + bool_string);
+  string Loader::ReadString() {
+    Expect('"');
+    size_t begin = index[next - 1];
+    const size_t end = NextStringEnd(begin);
+    return buffer.substr(begin + 1, end - begin - 1);
   }
 
-  Node LoadIntOrDouble(istream& input, int sign){
-	  //string s_int_part;
-	  //string s_fract_part;
-	  bool dot_found = false;
+  Node Loader::LoadArray() {
+    const size_t first = items_stack.size();
 
-	  int result_int = 0;
-	  double result_double = 0.0;
-	  int frac_mult = 10;
-	  while (isdigit(input.peek()) || input.peek() == '.') {
-		  char c = input.get();
-		  if(c == '.'){
-			  dot_found = true;
-			  result_double = result_int;
-			  continue;
-		  }
+    for (char c = PeekChar(); c != ']'; c = PeekChar()) {
+      if (c == ',') {
+        Skip();
+        continue;
+      }
+      Node item = LoadNode();
+      items_stack.push_back(item);
+    }
+    Skip();
 
-		  if(dot_found){
-			  //s_fract_part += c;
-			  result_double += double(c - '0') / frac_mult;
-			  frac_mult *= 10;
-		  } else {
-			  //s_int_part += c;
-			  result_int *= 10;
-			  result_int += c - '0';
-		  }
-	  }
+    const size_t count = items_stack.size() - first;
+    return Node(Array(MoveToArena(items_stack, first), count));
+  }
+
+  // Скаляр тянется до следующего структурного символа
+  Node Loader::LoadScalar(size_t begin) {
+    size_t end = PeekPosition(begin);
+    if (end == string::npos) {
+      end = buffer.size();
+    }
 
-	  if(!dot_found){
-		  /*int result = 0;
-		  for (const char c: s_int_part) {
-			result *= 10;
-			result += c - '0';
-		  }*/
-		  return Node(IntValue(sign * result_int));
-		  //return Node(IntValue(stoi(s_int_part)));
-	  }
+    string_view text(buffer.data() + begin, end - begin);
+    text = text.substr(0, text.find_last_not_of(" \t\n\r") + 1);
 
-	  //return Node(DoubleValue(sign * stod(s_int_part + "." + s_fract_part)));
-	  return Node(DoubleValue(sign * result_double));
+    if (text == "true") {
+      return Node(BoolValue(true));
+    } else if (text == "false") {
+      return Node(BoolValue(false));
+    }
+    return ParseNumber(text);
   }
 
-  Node LoadString(istream& input) {
-    string line;
-    getline(input, line, '"');
-    return Node(move(line));
+  string_view Loader::LoadString(size_t begin) {
+    const size_t end = NextStringEnd(begin);
+    const size_t size = end - begin - 1;
+    if (size == 0) {
+      return {};
+    }
+    char* chars = static_cast<char*>(arena->allocate(size, alignof(char)));
+    copy(buffer.begin() + begin + 1, buffer.begin() + end, chars);
+    return {chars, size};
   }
 
-  Node LoadDict(istream& input) {
-    map<string, Node> result;
+  Node Loader::LoadDict() {
+    const size_t first = members_stack.size();
 
-    for (char c; input >> c && c != '}'; ) {
+    for (char c = PeekChar(); c != '}'; c = PeekChar()) {
       if (c == ',') {
-        input >> c;
+        Skip();
+        continue;
+      } else if (c != '"') {
+        throw invalid_argument(string("Json: unexpected char in object - ") + c);
       }
 
-      string key = LoadString(input).AsString();
-      input >> c;
-      result.emplace(move(key), LoadNode(input));
+      Skip();
+      string_view key = LoadString(index[next - 1]);
+      Expect(':');
+      Node value = LoadNode();
+      members_stack.emplace_back(key, value);
     }
+    Skip();
 
-    return Node(move(result));
+    const size_t count = members_stack.size() - first;
+    return Node(Map(MoveToArena(members_stack, first), count));
   }
 
-  Node LoadNode(istream& input) {
-    char c;
-    input >> c;
+  Node Loader::LoadNode() {
+    const char c = PeekChar();
+    Skip();
+    const size_t begin = index[next - 1];
 
     if (c == '[') {
-      return LoadArray(input);
+      return LoadArray();
     } else if (c == '{') {
-      return LoadDict(input);
+      return LoadDict();
     } else if (c == '"') {
-      return LoadString(input);
-    } else if (c == 't' || c == 'f') {
-      return LoadBool(input, c);
-    } else if (isdigit(c) || c == '.' || c == '+' || c == '-') {
-    	int sign = 1;
-    	if(isdigit(c) || c == '.'){
-    		input.putback(c);
-    	} else if(c == '-'){
-    		sign = -1;
-    	}
-
-        return LoadIntOrDouble(input, sign);
-    } else {
-    	//input.putback(c);
-    	//return Node(IntValue(0));
-    	throw invalid_argument("unexpected char - " + c);
-      //input.putback(c);
-      //return LoadIntOrDouble(input);
+      return Node(LoadString(begin));
+    } else if (c == ']' || c == '}' || c == ':' || c == ',') {
+      throw invalid_argument(string("unexpected char - ") + c);
+    }
+    return LoadScalar(begin);
+  }
+
+  Node ParseNumber(string_view text) {
+    if (!text.empty() && text.front() == '+') {
+      text.remove_prefix(1);
+    }
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+
+    if (text.find_first_of(".eE") == string_view::npos) {
+      int64_t result_int = 0;
+      if (const auto [ptr, ec] = from_chars(first, last, result_int); ec == errc() && ptr == last) {
+        return Node(IntValue(result_int));
+      } else if (ec != errc::result_out_of_range) {
+        throw invalid_argument("Json::ParseNumber: incorrect number " + string(text));
+      }
     }
+
+    double result_double = 0.0;
+    if (const auto [ptr, ec] = from_chars(first, last, result_double); ec != errc() || ptr != last) {
+      throw invalid_argument("Json::ParseNumber: incorrect number " + string(text));
+    }
+    return Node(DoubleValue(result_double));
   }
 
   Document Load(istream& input) {
-    return Document{LoadNode(input)};
+    auto arena = make_unique<pmr::monotonic_buffer_resource>();
+    const Node root = Loader(input).Load(*arena);
+    return Document{move(arena), root};
+  }
+
+  Reader::Reader(istream& input)
+    : arena_buffer(INITIAL_ARENA_SIZE),
+      arena(arena_buffer.data(), arena_buffer.size(), &arena_upstream),
+      loader(make_unique<Loader>(input)) {
+  }
+
+  Reader::~Reader() = default;
+
+  char Reader::PeekChar() {
+    return loader->PeekChar();
+  }
+
+  void Reader::Skip() {
+    loader->Skip();
+  }
+
+  void Reader::Expect(char expected) {
+    loader->Expect(expected);
+  }
+
+  string Reader::ReadKey() {
+    string key = loader->ReadString();
+    Expect(':');
+    return key;
+  }
+
+  Node Reader::ReadNode() {
+    arena.release();
+    return loader->Load(arena);
+  }
+
+  size_t Reader::GetArenaPeakSize() const {
+    return arena_buffer.size() + arena_upstream.GetPeak();
+  }
+
+  void* Reader::CountingResource::do_allocate(size_t bytes, size_t alignment) {
+    void* result = pmr::new_delete_resource()->allocate(bytes, alignment);
+    current += bytes;
+    peak = max(peak, current);
+    return result;
+  }
+
+  void Reader::CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    current -= bytes;
+  }
+
+  bool Reader::CountingResource::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+  }
+
+  LineReader::LineReader()
+    : arena_buffer(INITIAL_ARENA_SIZE),
+      arena(arena_buffer.data(), arena_buffer.size()),
+      loader(make_unique<Loader>(input, CHUNK_SIZE)) {
+  }
+
+  LineReader::~LineReader() = default;
+
+  Node LineReader::Parse(string_view line) {
+    input.clear();
+    input.str(string(line));
+    arena.release();
+    try {
+      const Node result = loader->Load(arena);
+      if (!loader->AtEnd()) {
+        throw invalid_argument("Json: unexpected data after value");
+      }
+      return result;
+    } catch (...) {
+      // Сканер мог остаться внутри строки: следующая строка разбирается с чистого состояния
+      loader = make_unique<Loader>(input, CHUNK_SIZE);
+      throw;
+    }
   }
 
 }
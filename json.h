@@ -1,17 +1,21 @@
 #pragma once
 
+#include <cstdint>
 #include <istream>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <sstream>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace Json {
 	struct IntValue {
-		size_t value;
-		explicit IntValue(size_t value_): value(value_) {}
+		int64_t value;
+		explicit IntValue(int64_t value_): value(value_) {}
 
-		operator size_t() const{
+		operator int64_t() const{
 			return value;
 		}
 	};
@@ -34,71 +38,240 @@ namespace Json {
 		}
 	};
 
+  class Node;
+  using KeyValue = std::pair<std::string_view, Node>;
 
+  // Непрерывный участок арены документа
+  template <typename T>
+  class Span {
+  public:
+    Span() = default;
+    Span(const T* begin, size_t size) : begin_(begin), size_(size) {}
+
+    const T* begin() const { return begin_; }
+    const T* end() const { return begin_ + size_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T& operator[](size_t index) const { return begin_[index]; }
 
-  class Node : std::variant<std::vector<Node>,
-                            std::map<std::string, Node>,
-							IntValue,
-							DoubleValue,
-							BoolValue,
-                            std::string> {
+  private:
+    const T* begin_ = nullptr;
+    size_t size_ = 0;
+  };
+
+  using Array = Span<Node>;
+
+  // Плоский массив пар ключ-значение в порядке документа, поиск линейный:
+  // в наших объектах единицы ключей
+  class Map : public Span<KeyValue> {
   public:
-    using variant::variant;
+    using Span<KeyValue>::Span;
 
-    const auto& AsArray() const {
-      return std::get<std::vector<Node>>(*this);
+    const KeyValue* find(std::string_view key) const;
+  };
+
+  // Узел не владеет памятью: массивы, объекты и строки лежат в арене документа,
+  // поэтому узел тривиально копируется и разрушается
+  class Node {
+  public:
+    enum class Type : uint8_t {
+      Null,
+      Array,
+      Map,
+      Int,
+      Double,
+      Bool,
+      String
+    };
+
+    Node() : type(Type::Null), size(0), int_value(0) {}
+    explicit Node(IntValue value) : type(Type::Int), size(0), int_value(value) {}
+    explicit Node(DoubleValue value) : type(Type::Double), size(0), double_value(value) {}
+    explicit Node(BoolValue value) : type(Type::Bool), size(0), bool_value(value) {}
+    explicit Node(Array value) : type(Type::Array), size(value.size()), items(value.begin()) {}
+    explicit Node(Map value) : type(Type::Map), size(value.size()), members(value.begin()) {}
+    explicit Node(std::string_view value) : type(Type::String), size(value.size()), chars(value.data()) {}
+
+    Array AsArray() const {
+      Check(Type::Array);
+      return {items, size};
     }
-    const auto& AsMap() const {
-      return std::get<std::map<std::string, Node>>(*this);
+    Map AsMap() const {
+      Check(Type::Map);
+      return {members, size};
     }
-    int AsInt() const {
-      return std::get<IntValue>(*this);
+    int64_t AsInt() const {
+      Check(Type::Int);
+      return int_value;
     }
     double AsDouble() const {
-    	return std::get<DoubleValue>(*this);
-	}
+      Check(Type::Double);
+      return double_value;
+    }
     bool AsBool() const {
-	  return std::get<BoolValue>(*this);
-	}
-    const auto& AsString() const {
-      return std::get<std::string>(*this);
+      Check(Type::Bool);
+      return bool_value;
+    }
+    std::string_view AsString() const {
+      Check(Type::String);
+      return {chars, size};
     }
 
     bool IsBool() const {
-	  return std::holds_alternative<BoolValue>(*this);
-	}
+      return type == Type::Bool;
+    }
 
     bool IsInt() const {
-	  return std::holds_alternative<IntValue>(*this);
-	}
+      return type == Type::Int;
+    }
 
     bool IsDouble() const {
-	  return std::holds_alternative<DoubleValue>(*this);
-	}
+      return type == Type::Double;
+    }
 
     bool IsString() const {
-	  return std::holds_alternative<std::string>(*this);
-	}
+      return type == Type::String;
+    }
 
     bool IsMap() const {
-	  return std::holds_alternative<std::map<std::string, Node>>(*this);
-	}
+      return type == Type::Map;
+    }
 
     bool IsArray() const {
-	  return std::holds_alternative<std::vector<Node>>(*this);
-	}
+      return type == Type::Array;
+    }
+
+  private:
+    Type type;
+    uint32_t size;
+    union {
+      int64_t int_value;
+      double double_value;
+      bool bool_value;
+      const Node* items;
+      const KeyValue* members;
+      const char* chars;
+    };
+
+    void Check(Type expected) const;
   };
 
+  // Документ владеет ареной: освобождение дерева - это освобождение арены
   class Document {
   public:
-    explicit Document(Node root);
+    Document(std::unique_ptr<std::pmr::monotonic_buffer_resource> arena, Node root);
 
     const Node& GetRoot() const;
 
   private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
     Node root;
   };
 
   Document Load(std::istream& input);
 
+  // Число в записи JSON (с экспонентой). Целые, не влезающие в int64_t, читаются как double;
+  // double округляется корректно (std::from_chars)
+  Node ParseNumber(std::string_view text);
+
+  class Loader;
+
+  // Потоковый разбор: дерево строится только для текущего значения,
+  // обход контейнеров верхнего уровня идет через обратные вызовы
+  class Reader {
+  public:
+    explicit Reader(std::istream& input);
+    ~Reader();
+
+    // on_key(const std::string& key) обязан прочитать значение ключа
+    template <typename Callback>
+    void ReadMap(Callback on_key);
+
+    // on_item() обязан прочитать очередной элемент
+    template <typename Callback>
+    void ReadArray(Callback on_item);
+
+    // Узел действителен до следующего вызова ReadNode: арена переиспользуется
+    Node ReadNode();
+
+    // Начальный буфер арены плюс наибольший объем, взятый сверх него
+    size_t GetArenaPeakSize() const;
+
+  private:
+    static constexpr size_t INITIAL_ARENA_SIZE = 64 * 1024;
+
+    // Сверх начального буфера арена берет память у new/delete; считаем, сколько максимум было взято
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+      size_t GetPeak() const {
+        return peak;
+      }
+
+    private:
+      size_t current = 0;
+      size_t peak = 0;
+
+      void* do_allocate(size_t bytes, size_t alignment) override;
+      void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    std::vector<std::byte> arena_buffer;
+    CountingResource arena_upstream;
+    std::pmr::monotonic_buffer_resource arena;
+    std::unique_ptr<Loader> loader;
+
+    char PeekChar();
+    void Skip();
+    void Expect(char expected);
+    std::string ReadKey();
+  };
+
+  // Независимые значения, каждое в своей строке (построчные запросы сервера).
+  // Арена и буферы переиспользуются; после значения в строке допустимы только пробелы
+  class LineReader {
+  public:
+    LineReader();
+    ~LineReader();
+
+    // Узел действителен до следующего вызова Parse
+    Node Parse(std::string_view line);
+
+  private:
+    static constexpr size_t CHUNK_SIZE = 4 * 1024;
+    static constexpr size_t INITIAL_ARENA_SIZE = 4 * 1024;
+
+    std::istringstream input;
+    std::vector<std::byte> arena_buffer;
+    std::pmr::monotonic_buffer_resource arena;
+    std::unique_ptr<Loader> loader;
+  };
+
+  template <typename Callback>
+  void Reader::ReadMap(Callback on_key) {
+    Expect('{');
+    for (char c = PeekChar(); c != '}'; c = PeekChar()) {
+      if (c == ',') {
+        Skip();
+        continue;
+      }
+      const std::string key = ReadKey();
+      on_key(key);
+    }
+    Skip();
+  }
+
+  template <typename Callback>
+  void Reader::ReadArray(Callback on_item) {
+    Expect('[');
+    for (char c = PeekChar(); c != ']'; c = PeekChar()) {
+      if (c == ',') {
+        Skip();
+        continue;
+      }
+      on_item();
+    }
+    Skip();
+  }
+
 }
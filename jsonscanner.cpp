@@ -0,0 +1,185 @@
+#include "jsonscanner.h"
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__PCLMUL__)
+#include <immintrin.h>
+#endif
+
+namespace Json {
+
+  namespace {
+
+  const size_t BLOCK_SIZE = 64;
+
+  // Битовые маски блока из 64 байт: бит i соответствует байту i
+  struct BlockMasks {
+    uint64_t quote;
+    uint64_t op;
+    uint64_t whitespace;
+  };
+
+#if defined(__AVX2__)
+  uint64_t MoveMask(__m256i lo, __m256i hi) {
+    const uint32_t lo_mask = static_cast<uint32_t>(_mm256_movemask_epi8(lo));
+    const uint32_t hi_mask = static_cast<uint32_t>(_mm256_movemask_epi8(hi));
+    return lo_mask | (static_cast<uint64_t>(hi_mask) << 32);
+  }
+
+  BlockMasks Classify(const char* block) {
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+    auto eq = [](__m256i chunk, char c) {
+      return _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c));
+    };
+    //'[' и ']' отличаются от '{' и '}' только битом 0x20
+    auto op = [&](__m256i chunk) {
+      const __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+      return _mm256_or_si256(
+          _mm256_or_si256(eq(lower, '{'), eq(lower, '}')),
+          _mm256_or_si256(eq(chunk, ':'), eq(chunk, ',')));
+    };
+    auto whitespace = [&](__m256i chunk) {
+      return _mm256_or_si256(
+          _mm256_or_si256(eq(chunk, ' '), eq(chunk, '\n')),
+          _mm256_or_si256(eq(chunk, '\t'), eq(chunk, '\r')));
+    };
+
+    return {
+      MoveMask(eq(lo, '"'), eq(hi, '"')),
+      MoveMask(op(lo), op(hi)),
+      MoveMask(whitespace(lo), whitespace(hi))
+    };
+  }
+#elif defined(__SSE2__)
+  uint64_t MoveMask(const __m128i (&chunks)[4]) {
+    uint64_t result = 0;
+    for (int i = 0; i < 4; ++i) {
+      result |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(chunks[i]))) << (16 * i);
+    }
+    return result;
+  }
+
+  BlockMasks Classify(const char* block) {
+    __m128i quote[4];
+    __m128i op[4];
+    __m128i whitespace[4];
+    for (int i = 0; i < 4; ++i) {
+      const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+      auto eq = [](__m128i value, char c) {
+        return _mm_cmpeq_epi8(value, _mm_set1_epi8(c));
+      };
+      const __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+
+      quote[i] = eq(chunk, '"');
+      op[i] = _mm_or_si128(
+          _mm_or_si128(eq(lower, '{'), eq(lower, '}')),
+          _mm_or_si128(eq(chunk, ':'), eq(chunk, ',')));
+      whitespace[i] = _mm_or_si128(
+          _mm_or_si128(eq(chunk, ' '), eq(chunk, '\n')),
+          _mm_or_si128(eq(chunk, '\t'), eq(chunk, '\r')));
+    }
+    return {MoveMask(quote), MoveMask(op), MoveMask(whitespace)};
+  }
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  //Бит i результата - xor битов 0..i: единицы от открывающей кавычки до закрывающей
+  uint64_t PrefixXor(uint64_t bits) {
+#if defined(__PCLMUL__)
+    const __m128i product = _mm_clmulepi64_si128(
+        _mm_set_epi64x(0, static_cast<long long>(bits)), _mm_set1_epi8(-1), 0);
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+#else
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+#endif
+  }
+
+  uint32_t* WriteBlock(const BlockMasks& masks, size_t valid_count, uint32_t base,
+                       ScanState& state, uint32_t* out) {
+    const uint64_t valid = valid_count == BLOCK_SIZE ? ~uint64_t(0) : (uint64_t(1) << valid_count) - 1;
+
+    const uint64_t in_string = PrefixXor(masks.quote) ^ (state.in_string ? ~uint64_t(0) : 0);
+    state.in_string = (in_string >> 63) != 0;
+
+    const uint64_t scalar = ~(masks.quote | masks.op | masks.whitespace | in_string) & valid;
+    const uint64_t scalar_starts = scalar & ~((scalar << 1) | (state.prev_scalar ? 1 : 0));
+    state.prev_scalar = ((scalar >> (valid_count - 1)) & 1) != 0;
+
+    for (uint64_t structurals = (masks.op & ~in_string) | masks.quote | scalar_starts;
+         structurals != 0;
+         structurals &= structurals - 1) {
+      *out++ = base + static_cast<uint32_t>(__builtin_ctzll(structurals));
+    }
+    return out;
+  }
+#endif
+
+  }
+
+  size_t ScanStructuralsScalar(const char* data, size_t size, uint32_t base, ScanState& state, uint32_t* index) {
+    uint32_t* out = index;
+    for (size_t i = 0; i < size; ++i) {
+      const char c = data[i];
+      const uint32_t position = base + static_cast<uint32_t>(i);
+      if (state.in_string) {
+        if (c == '"') {
+          *out++ = position;
+          state.in_string = false;
+        }
+        continue;
+      }
+
+      switch (c) {
+      case '"':
+        *out++ = position;
+        state.in_string = true;
+        state.prev_scalar = false;
+        break;
+      case '{': case '}': case '[': case ']': case ':': case ',':
+        *out++ = position;
+        state.prev_scalar = false;
+        break;
+      case ' ': case '\n': case '\t': case '\r':
+        state.prev_scalar = false;
+        break;
+      default:
+        if (!state.prev_scalar) {
+          *out++ = position;
+        }
+        state.prev_scalar = true;
+      }
+    }
+    return out - index;
+  }
+
+  size_t ScanStructurals(const char* data, size_t size, uint32_t base, ScanState& state, uint32_t* index) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    uint32_t* out = index;
+
+    size_t offset = 0;
+    for (; offset + BLOCK_SIZE <= size; offset += BLOCK_SIZE) {
+      out = WriteBlock(Classify(data + offset), BLOCK_SIZE, base + static_cast<uint32_t>(offset), state, out);
+    }
+
+    if (offset < size) {
+      char tail[BLOCK_SIZE];
+      memset(tail, ' ', BLOCK_SIZE);
+      memcpy(tail, data + offset, size - offset);
+      out = WriteBlock(Classify(tail), size - offset, base + static_cast<uint32_t>(offset), state, out);
+    }
+
+    return out - index;
+#else
+    return ScanStructuralsScalar(data, size, base, state, index);
+#endif
+  }
+
+}
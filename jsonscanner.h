@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Json {
+
+  // Состояние сканера между соседними кусками входа
+  struct ScanState {
+    bool in_string = false;
+    bool prev_scalar = false;
+  };
+
+  // Первая стадия разбора: позиции структурных символов { } [ ] : , вне строк,
+  // всех кавычек и первых символов скаляров (чисел, true/false).
+  // Позиции со смещением base пишутся в index (не больше size штук), возвращается их количество.
+  // Экранирование в строках не поддерживается, как и во второй стадии.
+  // Используется AVX2 или SSE2, если они доступны при сборке, иначе скалярный код.
+  size_t ScanStructurals(const char* data, size_t size, uint32_t base, ScanState& state, uint32_t* index);
+
+  // Скалярный вариант, для сравнения в замерах
+  size_t ScanStructuralsScalar(const char* data, size_t size, uint32_t base, ScanState& state, uint32_t* index);
+
+}
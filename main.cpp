@@ -1,12 +1,88 @@
 #include <fstream>
 
+#include "benchmark.h"
 #include "busmanager.h"
+#include "client.h"
 #include "profile.h"
+#include "server.h"
 
 
 using namespace std;
 
-int main(){
+int main(int argc, char* argv[]){
+	if(argc == 4 && string(argv[1]) == "--bench"){
+		return RunBenchmark(argv[2], argv[3]);
+	}
+
+	//Снимок сети из полного входного файла
+	if(argc == 4 && string(argv[1]) == "--make-snapshot"){
+		ifstream input(argv[2], ios::binary);
+		ofstream snapshot(argv[3], ios::binary);
+		if(!input || !snapshot){
+			std::cout << "Не удалось открыть " << argv[2] << " или " << argv[3] << '\n';
+			return 1;
+		}
+		BusManager().ReadNetwork(input).SaveSnapshot(snapshot);
+		return 0;
+	}
+
+	//Ответы на stat_requests по готовому снимку
+	if(argc == 5 && string(argv[1]) == "--snapshot"){
+		ifstream snapshot(argv[2], ios::binary);
+		ifstream input(argv[3], ios::binary);
+		ofstream output(argv[4], ios::binary);
+		if(!snapshot || !input || !output){
+			std::cout << "Не удалось открыть файлы снимка, запросов или ответа" << '\n';
+			return 1;
+		}
+		BusManager bm;
+		{
+			LOG_DURATION("bm.LoadSnapshot")
+			bm.LoadSnapshot(snapshot);
+		}
+		{
+			LOG_DURATION("bm.Process")
+			bm.Process(input, output);
+		}
+		return 0;
+	}
+
+	//Обычная обработка с отчетами о памяти в stderr после каждой фазы загрузки и в конце
+	if(argc == 4 && string(argv[1]) == "--memory-report"){
+		ifstream input(argv[2], ios::binary);
+		ofstream output(argv[3], ios::binary);
+		if(!input || !output){
+			std::cout << "Не удалось открыть " << argv[2] << " или " << argv[3] << '\n';
+			return 1;
+		}
+		BusManager bm;
+		bm.SetMemoryReport(&cerr).Process(input, output);
+		bm.WriteMemoryReport(cerr);
+		return 0;
+	}
+
+	//Постоянный режим: сеть из входного файла, дальше запросы по строке из stdin или с сокета.
+	//По SIGHUP сеть перечитывается из того же файла без остановки обслуживания
+	if((argc == 3 || argc == 4) && string(argv[1]) == "--serve"){
+		std::unique_ptr<const ReadOnlyNetwork> network;
+		{
+			LOG_DURATION("ReadOnlyNetwork::Load")
+			network = ReadOnlyNetwork::Load(argv[2]);
+		}
+		Server server(std::move(network));
+		server.ReloadOnSignal(argv[2]);
+		if(argc == 4){
+			server.ServeSocket(argv[3]);
+		} else {
+			server.Serve(cin, cout);
+		}
+		return 0;
+	}
+
+	if(argc == 3 && string(argv[1]) == "--client"){
+		return RunClient(argv[2]);
+	}
+
 	BusManager bm;
 
 	string inputFilePath = "/home/sergey/Books/coursera-c++brown-4/Экзамен - граф/transport-input2.json";
@@ -16,31 +92,13 @@ int main(){
 		return 1;
 	}
 
-	stringstream in_ss;
-	std::copy(
-	        std::istreambuf_iterator<char>(input),
-	        std::istreambuf_iterator<char>( ),
-	        std::ostreambuf_iterator<char>(in_ss));
-
-	{
-		LOG_DURATION("bm.Read")
-		bm.Read(in_ss);
-	}
-
-	stringstream out_ss;
-	{
-		LOG_DURATION("bm.WriteResponse")
-		bm.WriteResponse(out_ss);
-	}
-
 	string outputFilePath = "/home/sergey/Books/coursera-c++brown-4/result2.json";
 	ofstream output(outputFilePath, ios::binary);
 
-	std::copy(
-		        std::istreambuf_iterator<char>(out_ss),
-		        std::istreambuf_iterator<char>( ),
-		        std::ostreambuf_iterator<char>(output));
+	{
+		LOG_DURATION("bm.Process")
+		bm.Process(input, output);
+	}
 
 	return 0;
 }
-
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//Оценки занятой кучи для отчета о памяти; служебные байты аллокатора не учитываются
+
+template <typename T>
+size_t VectorMemoryUsage(const std::vector<T>& items){
+	return items.capacity() * sizeof(T);
+}
+
+//Короткие строки лежат внутри самого объекта
+inline size_t StringMemoryUsage(const std::string& text){
+	static const size_t inline_capacity = std::string().capacity();
+	return text.capacity() > inline_capacity ? text.capacity() + 1 : 0;
+}
+
+//Узел: указатель на следующий, пара ключ-значение и сохраненный хеш; плюс массив корзин.
+//Память, на которую ссылаются сами ключи и значения, не входит
+template <typename Map>
+size_t UnorderedMapMemoryUsage(const Map& map){
+	return map.size() * (2 * sizeof(void*) + sizeof(typename Map::value_type)) + map.bucket_count() * sizeof(void*);
+}
+
+//Строка отчета: число элементов, под сколько выделено место, байты в куче.
+//load_factor < 0 - не хеш-таблица
+struct MemoryUsageEntry {
+	const char* name;
+	size_t count;
+	size_t capacity;
+	size_t bytes;
+	double load_factor = -1.0;
+};
@@ -0,0 +1,175 @@
+#include "nameindex.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+//Финальное перемешивание splitmix64
+uint64_t Mix(uint64_t key){
+	key ^= key >> 30;
+	key *= 0xBF58476D1CE4E5B9;
+	key ^= key >> 27;
+	key *= 0x94D049BB133111EB;
+	key ^= key >> 31;
+	return key;
+}
+
+//Перемножение 64 x 64 -> 128 бит, старшая половина смешивается с младшей
+uint64_t MultiplyMix(uint64_t lhs, uint64_t rhs){
+	const unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+	return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15;
+
+uint64_t Load(const char* data, size_t size){
+	uint64_t result = 0;
+	std::memcpy(&result, data, size);
+	return result;
+}
+
+//Имя читается кусками по 8 байт, на кусок одно умножение. Хвост собирается
+//загрузками фиксированной длины, как в wyhash, чтобы не звать memcpy переменной длины
+uint64_t HashName(std::string_view name, uint64_t seed){
+	const char* data = name.data();
+	size_t size = name.size();
+	uint64_t hash = seed ^ (size * HASH_MULTIPLIER);
+	for(; size > sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)){
+		hash = MultiplyMix(hash ^ Load(data, sizeof(uint64_t)), HASH_MULTIPLIER);
+	}
+
+	uint64_t tail = 0;
+	if(size >= 4){
+		tail = Load(data, 4) << 32 | Load(data + size - 4, 4);
+	} else if(size > 0){
+		tail = static_cast<uint64_t>(static_cast<unsigned char>(data[0])) << 16
+				| static_cast<uint64_t>(static_cast<unsigned char>(data[size / 2])) << 8
+				| static_cast<unsigned char>(data[size - 1]);
+	}
+	return MultiplyMix(hash ^ tail, HASH_MULTIPLIER);
+}
+
+//Равномерно отображает x в [0, range) без деления
+size_t FastRange(uint64_t x, size_t range){
+	return static_cast<size_t>((static_cast<unsigned __int128>(x) * range) >> 64);
+}
+
+}
+
+size_t NameIndex::GetBucket(uint64_t hash) const {
+	return FastRange(hash, pilots.size());
+}
+
+size_t NameIndex::GetSlot(uint64_t hash, uint64_t pilot_hash, size_t count) const {
+	return FastRange(MultiplyMix(hash ^ pilot_hash, HASH_MULTIPLIER), count);
+}
+
+bool NameIndex::TryBuild(const std::vector<std::string_view>& names, std::vector<uint32_t>& slot_ids){
+	const size_t count = names.size();
+	std::vector<uint64_t> hashes(count);
+	for(size_t i = 0; i < count; i++){
+		hashes[i] = HashName(names[i], seed);
+	}
+
+	//Ключи по корзинам подряд: bucket_offsets[bucket]..bucket_offsets[bucket + 1]
+	std::vector<uint32_t> bucket_offsets(pilots.size() + 1, 0);
+	for(const uint64_t hash: hashes){
+		bucket_offsets[GetBucket(hash) + 1]++;
+	}
+	std::partial_sum(bucket_offsets.begin(), bucket_offsets.end(), bucket_offsets.begin());
+	std::vector<uint32_t> bucket_keys(count);
+	std::vector<uint32_t> fill(bucket_offsets.begin(), bucket_offsets.end() - 1);
+	for(uint32_t i = 0; i < count; i++){
+		bucket_keys[fill[GetBucket(hashes[i])]++] = i;
+	}
+
+	//Большие корзины размещаем первыми, пока свободных ячеек много
+	std::vector<uint32_t> bucket_order(pilots.size());
+	std::iota(bucket_order.begin(), bucket_order.end(), 0);
+	std::stable_sort(bucket_order.begin(), bucket_order.end(), [&bucket_offsets](uint32_t lhs, uint32_t rhs){
+		return bucket_offsets[lhs + 1] - bucket_offsets[lhs] > bucket_offsets[rhs + 1] - bucket_offsets[rhs];
+	});
+
+	const uint64_t max_pilot = std::max<uint64_t>(1 << 16, count * 16);
+	std::vector<bool> taken(count, false);
+	std::vector<size_t> slots;
+	for(const uint32_t bucket: bucket_order){
+		const uint32_t begin = bucket_offsets[bucket];
+		const uint32_t end = bucket_offsets[bucket + 1];
+		if(begin == end){
+			break;
+		}
+
+		bool placed = false;
+		for(uint64_t pilot = 0; pilot < max_pilot && !placed; pilot++){
+			slots.clear();
+			placed = true;
+			for(uint32_t i = begin; i < end; i++){
+				const size_t slot = GetSlot(hashes[bucket_keys[i]], Mix(pilot), count);
+				if(taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()){
+					placed = false;
+					break;
+				}
+				slots.push_back(slot);
+			}
+			if(placed){
+				pilots[bucket] = Mix(pilot);
+			}
+		}
+		if(!placed){
+			return false;
+		}
+
+		for(uint32_t i = begin; i < end; i++){
+			taken[slots[i - begin]] = true;
+			slot_ids[slots[i - begin]] = bucket_keys[i];
+		}
+	}
+	return true;
+}
+
+void NameIndex::Build(const std::vector<std::string_view>& names){
+	const size_t count = names.size();
+	pilots.assign(count / BUCKET_SIZE + 1, 0);
+	entries.clear();
+	chars.clear();
+
+	std::vector<uint32_t> slot_ids(count);
+	bool built = false;
+	for(size_t attempt = 0; attempt < MAX_BUILD_ATTEMPTS && !built; attempt++){
+		seed = Mix(attempt + 1);
+		std::fill(pilots.begin(), pilots.end(), 0);
+		built = TryBuild(names, slot_ids);
+	}
+	if(!built){
+		throw std::invalid_argument("NameIndex::Build: names are not unique");
+	}
+
+	size_t total_size = 0;
+	for(const std::string_view name: names){
+		total_size += name.size();
+	}
+	chars.reserve(total_size);
+	entries.reserve(count + 1);
+	for(size_t slot = 0; slot < count; slot++){
+		entries.push_back({static_cast<uint32_t>(chars.size()), slot_ids[slot]});
+		chars.append(names[slot_ids[slot]]);
+	}
+	entries.push_back({static_cast<uint32_t>(chars.size()), 0});
+}
+
+std::optional<uint32_t> NameIndex::Find(std::string_view name) const {
+	if(entries.size() < 2){
+		return std::nullopt;
+	}
+
+	const uint64_t hash = HashName(name, seed);
+	const size_t slot = GetSlot(hash, pilots[GetBucket(hash)], entries.size() - 1);
+	const Entry& entry = entries[slot];
+	if(std::string_view(chars.data() + entry.offset, entries[slot + 1].offset - entry.offset) != name){
+		return std::nullopt;
+	}
+	return entry.id;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Неизменяемый словарь имя -> id на минимальной совершенной хеш-функции (hash and displace).
+//Ключ хешируется один раз: старшие биты выбирают корзину, сдвиг корзины - ячейку.
+//У каждого ключа своя ячейка из count, так что поиск - одна ячейка и одно сравнение.
+//Имена лежат подряд в одном буфере
+class NameIndex {
+public:
+	//id имени - его индекс в names; имена должны быть различны
+	void Build(const std::vector<std::string_view>& names);
+
+	std::optional<uint32_t> Find(std::string_view name) const;
+
+	size_t Size() const {
+		return entries.empty() ? 0 : entries.size() - 1;
+	}
+
+	size_t MemoryUsage() const {
+		return pilots.capacity() * sizeof(uint64_t) + entries.capacity() * sizeof(Entry) + chars.capacity();
+	}
+
+private:
+	//В среднем ключей на корзину
+	static constexpr size_t BUCKET_SIZE = 4;
+	static constexpr size_t MAX_BUILD_ATTEMPTS = 16;
+
+	uint64_t seed = 0;
+	//Сдвиг для каждой корзины, хранится уже перемешанным
+	std::vector<uint64_t> pilots;
+	//По ячейке: имя chars[entries[slot].offset..entries[slot + 1].offset) и его id.
+	//Последний элемент - только граница имени в предпоследнем
+	struct Entry {
+		uint32_t offset;
+		uint32_t id;
+	};
+	std::vector<Entry> entries;
+	std::string chars;
+
+	size_t GetBucket(uint64_t hash) const;
+	size_t GetSlot(uint64_t hash, uint64_t pilot_hash, size_t count) const;
+
+	//Подбор сдвигов для всех корзин при данном seed; false - какой-то корзине сдвиг не нашелся
+	bool TryBuild(const std::vector<std::string_view>& names, std::vector<uint32_t>& slot_ids);
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Вызывает func(i) для i из [0, count), разбивая диапазон на равные куски по потокам.
+//Куски меньше min_chunk не дробятся: на малых данных всё выполняется в текущем потоке.
+//Первое исключение из потоков пробрасывается вызывающему
+template <typename Func>
+void ParallelFor(size_t count, Func func, size_t min_chunk = 64){
+	const size_t hardware_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	const size_t thread_count = std::min(hardware_threads, std::max<size_t>(1, count / std::max<size_t>(1, min_chunk)));
+
+	if(thread_count == 1){
+		for(size_t i = 0; i < count; i++){
+			func(i);
+		}
+		return;
+	}
+
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	auto run_chunk = [&](size_t begin, size_t end){
+		try{
+			for(size_t i = begin; i < end; i++){
+				func(i);
+			}
+		} catch(...){
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if(!error){
+				error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count - 1);
+	const size_t chunk_size = (count + thread_count - 1) / thread_count;
+	for(size_t begin = chunk_size; begin < count; begin += chunk_size){
+		threads.emplace_back(run_chunk, begin, std::min(count, begin + chunk_size));
+	}
+	run_chunk(0, std::min(count, chunk_size));
+
+	for(auto& thread: threads){
+		thread.join();
+	}
+	if(error){
+		std::rethrow_exception(error);
+	}
+}
+
+//Сортировка кусками по потокам с последующим попарным слиянием.
+//Результат тот же, что у std::sort, при строгом полном порядке less
+template <typename Iterator, typename Less>
+void ParallelSort(Iterator first, Iterator last, Less less, size_t min_chunk = 1 << 15){
+	const size_t count = last - first;
+	const size_t hardware_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	const size_t chunk_count = std::min(hardware_threads, std::max<size_t>(1, count / std::max<size_t>(1, min_chunk)));
+	if(chunk_count == 1){
+		std::sort(first, last, less);
+		return;
+	}
+
+	std::vector<size_t> bounds(chunk_count + 1);
+	for(size_t i = 0; i <= chunk_count; i++){
+		bounds[i] = count * i / chunk_count;
+	}
+
+	ParallelFor(chunk_count, [&](size_t i){
+		std::sort(first + bounds[i], first + bounds[i + 1], less);
+	}, 1);
+
+	for(size_t width = 1; width < chunk_count; width *= 2){
+		const size_t pair_count = (chunk_count + 2 * width - 1) / (2 * width);
+		ParallelFor(pair_count, [&](size_t pair){
+			const size_t begin = pair * 2 * width;
+			const size_t middle = std::min(begin + width, chunk_count);
+			const size_t end = std::min(begin + 2 * width, chunk_count);
+			if(middle < end){
+				std::inplace_merge(first + bounds[begin], first + bounds[middle], first + bounds[end], less);
+			}
+		}, 1);
+	}
+}
@@ -0,0 +1,17 @@
+#include "readonlynetwork.h"
+#include <fstream>
+#include <stdexcept>
+
+std::unique_ptr<const ReadOnlyNetwork> ReadOnlyNetwork::Load(const std::string& path){
+	std::ifstream input(path, std::ios::binary);
+	if(!input){
+		throw std::invalid_argument("ReadOnlyNetwork::Load: cannot open " + path);
+	}
+	std::unique_ptr<ReadOnlyNetwork> result(new ReadOnlyNetwork);
+	result->manager.Read(input);
+	return result;
+}
+
+void ReadOnlyNetwork::WriteResponse(const Json::Map& request, ResponseWriter& writer) const {
+	manager.WriteResponse(request, writer);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "busmanager.h"
+
+//Загруженная сеть только для запросов: снаружи виден лишь константный ответ на запрос
+//в формате stat_requests. Изменить сеть через нее нельзя, новая сеть - новый объект.
+//Ответы из нескольких потоков одновременно безопасны
+class ReadOnlyNetwork {
+public:
+	//Полный входной документ: base_requests и routing_settings, stat_requests не нужны
+	static std::unique_ptr<const ReadOnlyNetwork> Load(const std::string& path);
+
+	void WriteResponse(const Json::Map& request, ResponseWriter& writer) const;
+
+private:
+	ReadOnlyNetwork() = default;
+
+	BusManager manager;
+};
@@ -0,0 +1,143 @@
+#include "responsewriter.h"
+
+ResponseWriter::ResponseWriter(std::ostream& out, Format format, size_t flush_size)
+	: out(out), format(format), flush_size(flush_size) {
+	buffer.reserve(flush_size + flush_size / 4);
+}
+
+ResponseWriter::~ResponseWriter() {
+	Flush();
+}
+
+void ResponseWriter::Indent(size_t depth) {
+	buffer += '\n';
+	buffer.append(depth, '\t');
+}
+
+void ResponseWriter::BeginItem() {
+	if(after_key){
+		after_key = false;
+		return;
+	}
+
+	if(has_items.empty()){
+		return;
+	}
+
+	if(has_items.back()){
+		buffer += ',';
+	}
+	has_items.back() = true;
+
+	if(format == Format::Pretty){
+		Indent(has_items.size());
+	}
+}
+
+ResponseWriter& ResponseWriter::BeginArray() {
+	BeginItem();
+	buffer += '[';
+	has_items.push_back(false);
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::EndArray() {
+	const bool was_items = has_items.back();
+	has_items.pop_back();
+	if(was_items && format == Format::Pretty){
+		Indent(has_items.size());
+	}
+	buffer += ']';
+	FlushIfFull();
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::BeginObject() {
+	BeginItem();
+	buffer += '{';
+	has_items.push_back(false);
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::EndObject() {
+	const bool was_items = has_items.back();
+	has_items.pop_back();
+	if(was_items && format == Format::Pretty){
+		Indent(has_items.size());
+	}
+	buffer += '}';
+	FlushIfFull();
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::Key(std::string_view key) {
+	BeginItem();
+	buffer += '"';
+	buffer += key;
+	buffer += (format == Format::Pretty) ? "\": " : "\":";
+	after_key = true;
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::Value(std::string_view value) {
+	BeginItem();
+	buffer += '"';
+	buffer += value;
+	buffer += '"';
+	FlushIfFull();
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::Value(const char* value) {
+	return Value(std::string_view(value));
+}
+
+//Как operator<< для double по умолчанию: %g с 6 значащими цифрами
+ResponseWriter& ResponseWriter::Value(double value) {
+	BeginItem();
+	char chars[32];
+	const auto result = std::to_chars(chars, chars + sizeof(chars), value, std::chars_format::general, 6);
+	buffer.append(chars, result.ptr);
+	FlushIfFull();
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::RawValue(std::string_view json) {
+	BeginItem();
+	buffer += json;
+	FlushIfFull();
+	return *this;
+}
+
+ResponseWriter& ResponseWriter::EndLine() {
+	buffer += '\n';
+	FlushIfFull();
+	return *this;
+}
+
+void ResponseWriter::FlushIfFull() {
+	if(buffer.size() >= flush_size){
+		Flush();
+	}
+}
+
+void ResponseWriter::Flush() {
+	if(buffer.empty()){
+		return;
+	}
+	out.write(buffer.data(), buffer.size());
+	bytes_flushed += buffer.size();
+	buffer.clear();
+}
+
+ResponseWriter::Format ResponseWriter::GetFormat() const {
+	return format;
+}
+
+size_t ResponseWriter::GetBytesWritten() const {
+	return bytes_flushed + buffer.size();
+}
+
+size_t ResponseWriter::GetDepth() const {
+	return has_items.size();
+}
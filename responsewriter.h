@@ -0,0 +1,75 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+//Формирование JSON-ответа в собственном буфере; в поток буфер сбрасывается крупными кусками.
+//Pretty повторяет прежнюю раскладку с табуляциями, Compact пишет без пробелов и переводов строк.
+class ResponseWriter {
+public:
+	enum class Format {
+		Pretty,
+		Compact
+	};
+
+	static const size_t DEFAULT_FLUSH_SIZE = 1 << 20;
+
+	explicit ResponseWriter(std::ostream& out, Format format = Format::Pretty, size_t flush_size = DEFAULT_FLUSH_SIZE);
+	~ResponseWriter();
+
+	ResponseWriter& BeginArray();
+	ResponseWriter& EndArray();
+	ResponseWriter& BeginObject();
+	ResponseWriter& EndObject();
+	ResponseWriter& Key(std::string_view key);
+
+	ResponseWriter& Value(std::string_view value);
+	ResponseWriter& Value(const char* value);
+	ResponseWriter& Value(double value);
+
+	template <typename Integer, typename = std::enable_if_t<std::is_integral_v<Integer> && !std::is_same_v<Integer, bool>>>
+	ResponseWriter& Value(Integer value);
+
+	//Готовое значение, записанное ResponseWriter того же формата на той же глубине, копируется как есть
+	ResponseWriter& RawValue(std::string_view json);
+
+	//Перевод строки после значения верхнего уровня: построчный вывод в любом формате
+	ResponseWriter& EndLine();
+
+	//Отдает накопленное в поток
+	void Flush();
+
+	Format GetFormat() const;
+	size_t GetBytesWritten() const;
+	//Число открытых контейнеров
+	size_t GetDepth() const;
+
+private:
+	std::ostream& out;
+	Format format;
+	size_t flush_size;
+	std::string buffer;
+	size_t bytes_flushed = 0;
+
+	//Для каждого открытого контейнера - были ли в нем элементы
+	std::vector<bool> has_items;
+	bool after_key = false;
+
+	void BeginItem();
+	void Indent(size_t depth);
+	void FlushIfFull();
+};
+
+template <typename Integer, typename>
+ResponseWriter& ResponseWriter::Value(Integer value) {
+	BeginItem();
+	char chars[24];
+	const auto result = std::to_chars(chars, chars + sizeof(chars), value);
+	buffer.append(chars, result.ptr);
+	FlushIfFull();
+	return *this;
+}
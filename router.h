@@ -7,7 +7,6 @@
 #include <cstdint>
 #include <iterator>
 #include <optional>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -21,17 +20,13 @@ namespace Graph {
   public:
     Router(const Graph& graph);
 
-    using RouteId = uint64_t;
+    // Только вес кратчайшего пути, без разворачивания ребер
+    std::optional<Weight> GetRouteWeight(VertexId from, VertexId to) const;
+    // Ребра кратчайшего пути в переданный вектор, без выделений при достаточной емкости
+    bool BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
 
-    struct RouteInfo {
-      RouteId id;
-      Weight weight;
-      size_t edge_count;
-    };
-
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
-    EdgeId GetRouteEdge(RouteId route_id, size_t edge_idx) const;
-    void ReleaseRoute(RouteId route_id);
+    // Байты в куче под таблицу кратчайших путей всех пар
+    size_t GetMemoryUsage() const;
 
   private:
     const Graph& graph_;
@@ -42,10 +37,6 @@ namespace Graph {
     };
     using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
 
-    using ExpandedRoute = std::vector<EdgeId>;
-    mutable RouteId next_route_id_ = 0;
-    mutable std::unordered_map<RouteId, ExpandedRoute> expanded_routes_cache_;
-
     void InitializeRoutesInternalData(const Graph& graph) {
       const size_t vertex_count = graph.GetVertexCount();
       for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
@@ -105,34 +96,36 @@ namespace Graph {
   }
 
   template <typename Weight>
-  std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to) const {
+  std::optional<Weight> Router<Weight>::GetRouteWeight(VertexId from, VertexId to) const {
+    if (const auto& route_internal_data = routes_internal_data_[from][to]) {
+      return route_internal_data->weight;
+    }
+    return std::nullopt;
+  }
+
+  template <typename Weight>
+  bool Router<Weight>::BuildRoute(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+    edges.clear();
     const auto& route_internal_data = routes_internal_data_[from][to];
     if (!route_internal_data) {
-      return std::nullopt;
+      return false;
     }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
     for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
          edge_id;
          edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge) {
       edges.push_back(*edge_id);
     }
     std::reverse(std::begin(edges), std::end(edges));
-
-    const RouteId route_id = next_route_id_++;
-    const size_t route_edge_count = edges.size();
-    expanded_routes_cache_[route_id] = std::move(edges);
-    return RouteInfo{route_id, weight, route_edge_count};
-  }
-
-  template <typename Weight>
-  EdgeId Router<Weight>::GetRouteEdge(RouteId route_id, size_t edge_idx) const {
-    return expanded_routes_cache_.at(route_id)[edge_idx];
+    return true;
   }
 
   template <typename Weight>
-  void Router<Weight>::ReleaseRoute(RouteId route_id) {
-    expanded_routes_cache_.erase(route_id);
+  size_t Router<Weight>::GetMemoryUsage() const {
+    size_t result = routes_internal_data_.capacity() * sizeof(typename RoutesInternalData::value_type);
+    for (const auto& row : routes_internal_data_) {
+      result += row.capacity() * sizeof(std::optional<RouteInternalData>);
+    }
+    return result;
   }
 
 }
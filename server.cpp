@@ -0,0 +1,238 @@
+#include "server.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "socketbuffer.h"
+
+Server::Server(std::unique_ptr<const ReadOnlyNetwork> network): reload_thread(&Server::RunReloadTasks, this) {
+	Publish(std::move(network));
+}
+
+Server::~Server(){
+	{
+		std::lock_guard guard(clients_mutex);
+		stopping = true;
+		for(const int client_fd: pending_clients){
+			close(client_fd);
+		}
+		pending_clients.clear();
+		//Чтение у обслуживаемых клиентов вернет конец потока, и Serve завершится
+		for(const int client_fd: active_clients){
+			shutdown(client_fd, SHUT_RDWR);
+		}
+	}
+	clients_changed.notify_all();
+	for(std::thread& worker: workers){
+		worker.join();
+	}
+
+	//SIGHUP в нем заблокирован и принимается sigwait: поток проснется и увидит stopping
+	if(signal_thread.joinable()){
+		pthread_kill(signal_thread.native_handle(), SIGHUP);
+		signal_thread.join();
+	}
+
+	//Начатая перезагрузка успеет опубликовать свой снимок до выхода потока
+	{
+		std::lock_guard guard(tasks_mutex);
+		reload_stopping = true;
+	}
+	tasks_changed.notify_all();
+	reload_thread.join();
+
+	//Запросов и перезагрузок больше нет: удалитель текущего снимка срабатывает здесь,
+	//а очередь снимков освобождаем сами, пока члены класса еще живы
+	std::atomic_exchange(&network, std::shared_ptr<const ReadOnlyNetwork>());
+	std::lock_guard guard(tasks_mutex);
+	retired_networks.clear();
+}
+
+void Server::Serve(std::istream& in, std::ostream& out) const {
+	Json::LineReader reader;
+	ResponseWriter writer(out, ResponseWriter::Format::Compact, RESPONSE_FLUSH_SIZE);
+	std::string line;
+	while(std::getline(in, line)){
+		if(line.find_first_not_of(" \t\r") == std::string::npos){
+			continue;
+		}
+
+		try {
+			const std::shared_ptr<const ReadOnlyNetwork> current = std::atomic_load(&network);
+			current->WriteResponse(reader.Parse(line).AsMap(), writer);
+		} catch(const std::exception&){
+			writer.BeginObject().Key("error_message").Value("invalid request").EndObject();
+		}
+		writer.EndLine().Flush();
+		out.flush();
+		if(!out){
+			return;
+		}
+	}
+}
+
+void Server::ServeSocket(const std::string& path){
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(address.sun_path)){
+		throw std::invalid_argument("Server::ServeSocket: socket path is too long");
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listen_fd < 0){
+		throw std::runtime_error("Server::ServeSocket: socket - " + std::string(std::strerror(errno)));
+	}
+	unlink(path.c_str());
+	if(bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0){
+		const std::string error = std::strerror(errno);
+		close(listen_fd);
+		throw std::runtime_error("Server::ServeSocket: bind - " + error);
+	}
+
+	while(workers.size() < WORKER_COUNT){
+		workers.emplace_back(&Server::ServeClients, this);
+	}
+
+	while(true){
+		const int client_fd = accept(listen_fd, nullptr, nullptr);
+		if(client_fd < 0){
+			if(errno == EINTR || errno == ECONNABORTED){
+				continue;
+			}
+			const std::string error = std::strerror(errno);
+			close(listen_fd);
+			throw std::runtime_error("Server::ServeSocket: accept - " + error);
+		}
+
+		std::unique_lock lock(clients_mutex);
+		if(pending_clients.size() >= MAX_PENDING_CLIENTS){
+			lock.unlock();
+			send(client_fd, BUSY_RESPONSE.data(), BUSY_RESPONSE.size(), MSG_NOSIGNAL);
+			close(client_fd);
+			continue;
+		}
+		pending_clients.push_back(client_fd);
+		lock.unlock();
+		clients_changed.notify_one();
+	}
+}
+
+//Поток пула: соединения из очереди по одному, до остановки сервера
+void Server::ServeClients(){
+	while(true){
+		int client_fd = -1;
+		{
+			std::unique_lock lock(clients_mutex);
+			clients_changed.wait(lock, [this]{
+				return stopping || !pending_clients.empty();
+			});
+			if(stopping){
+				return;
+			}
+			client_fd = pending_clients.front();
+			pending_clients.pop_front();
+			active_clients.insert(client_fd);
+		}
+
+		SocketBuffer buffer(client_fd);
+		std::istream in(&buffer);
+		std::ostream out(&buffer);
+		Serve(in, out);
+		//Из списка - до закрытия дескриптора, пока его номер не достался другому соединению
+		std::lock_guard guard(clients_mutex);
+		active_clients.erase(client_fd);
+	}
+}
+
+void Server::Reload(const std::string& path){
+	std::lock_guard guard(reload_mutex);
+	Publish(ReadOnlyNetwork::Load(path));
+}
+
+//Старый снимок отпускается здесь; если его еще держат запросы, удалитель сработает у последнего из них
+void Server::Publish(std::unique_ptr<const ReadOnlyNetwork> new_network){
+	std::shared_ptr<const ReadOnlyNetwork> shared_network(new_network.release(), [this](const ReadOnlyNetwork* old_network){
+		Retire(old_network);
+	});
+	std::atomic_exchange(&network, std::move(shared_network));
+}
+
+//Удалитель снимка: вызывается в потоке последнего запроса, поэтому только ставит снимок в очередь
+void Server::Retire(const ReadOnlyNetwork* old_network){
+	{
+		std::lock_guard guard(tasks_mutex);
+		retired_networks.emplace_back(old_network);
+	}
+	tasks_changed.notify_one();
+}
+
+//Поток перезагрузки: освобождает отпущенные снимки и перечитывает сеть по сигналу до остановки сервера
+void Server::RunReloadTasks(){
+	//Поток запущен раньше ReloadOnSignal: SIGHUP блокируем сами, его принимает только поток сигналов
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	std::unique_lock lock(tasks_mutex);
+	while(true){
+		tasks_changed.wait(lock, [this]{
+			return reload_stopping || reload_requested || !retired_networks.empty();
+		});
+		if(!retired_networks.empty()){
+			std::vector<std::unique_ptr<const ReadOnlyNetwork>> released = std::move(retired_networks);
+			retired_networks.clear();
+			lock.unlock();
+			released.clear();
+			lock.lock();
+		} else if(reload_requested && !reload_stopping){
+			reload_requested = false;
+			const std::string path = reload_path;
+			lock.unlock();
+			try {
+				Reload(path);
+				std::cerr << "Сеть перезагружена из " << path << std::endl;
+			} catch(const std::exception& e){
+				std::cerr << "Сеть не перезагружена, работает прежняя: " << e.what() << std::endl;
+			}
+			lock.lock();
+		} else if(reload_stopping){
+			return;
+		}
+	}
+}
+
+void Server::ReloadOnSignal(const std::string& path){
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	{
+		std::lock_guard guard(tasks_mutex);
+		reload_path = path;
+	}
+	signal_thread = std::thread([this, signals]{
+		while(true){
+			int signal_number = 0;
+			if(sigwait(&signals, &signal_number) != 0){
+				continue;
+			}
+			if(stopping){
+				return;
+			}
+			//Сигналы до начала перезагрузки сливаются в одну
+			{
+				std::lock_guard guard(tasks_mutex);
+				reload_requested = true;
+			}
+			tasks_changed.notify_one();
+		}
+	});
+}
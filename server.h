@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "readonlynetwork.h"
+
+//Постоянный режим: сеть загружается один раз, дальше запросы в формате stat_requests приходят
+//по одному в строке, ответ на каждый - одна строка компактного JSON, в порядке запросов.
+//Некорректная строка получает {"error_message": "invalid request"} и не прерывает обмен.
+//
+//Сеть хранится как ReadOnlyNetwork: запросам доступен только константный ответ, и она служит
+//неизменяемым снимком. Каждый запрос берет ссылку на текущий снимок и отвечает по нему до конца.
+//Перезагрузка строит новый снимок в потоке перезагрузки и атомарно подменяет указатель: запросы
+//ее не ждут, а начатые дорабатывают на старом снимке. Последний отпустивший старый снимок запрос
+//только передает его потоку перезагрузки, освобождается снимок там
+class Server {
+public:
+	explicit Server(std::unique_ptr<const ReadOnlyNetwork> network);
+	//Отключает клиентов сокета, дожидается всех потоков сервера и освобождает снимки
+	~Server();
+
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+
+	//Запросы из in до его конца, ответы в out; каждый ответ сбрасывается сразу
+	void Serve(std::istream& in, std::ostream& out) const;
+
+	//Unix domain socket по пути path, прежний файл сокета удаляется. Клиентов обслуживают
+	//WORKER_COUNT потоков, каждый по одному соединению; остальные ждут в очереди, а сверх
+	//MAX_PENDING_CLIENTS получают {"error_message":"server is busy"} и отключаются.
+	//Возвращает только при ошибке сокета
+	void ServeSocket(const std::string& path);
+
+	//Новый снимок из path вместо текущего. Старый освободит поток перезагрузки, когда его отпустит
+	//последний запрос; Reload этого не ждет
+	void Reload(const std::string& path);
+
+	//Перезагрузка из path по SIGHUP: поток сигналов только передает ее потоку перезагрузки.
+	//Вызывать до запуска других потоков: SIGHUP блокируется в вызывающем, остальные наследуют маску от него
+	void ReloadOnSignal(const std::string& path);
+
+private:
+	static const size_t RESPONSE_FLUSH_SIZE = 64 * 1024;
+	static const size_t WORKER_COUNT = 16;
+	static const size_t MAX_PENDING_CLIENTS = 64;
+	static constexpr std::string_view BUSY_RESPONSE = "{\"error_message\":\"server is busy\"}\n";
+
+	//Читается и подменяется только через std::atomic_load и std::atomic_exchange. Удалитель
+	//не освобождает снимок, а передает его в retired_networks
+	std::shared_ptr<const ReadOnlyNetwork> network;
+	std::mutex reload_mutex;
+
+	//Задачи потока перезагрузки, под tasks_mutex: перезагрузка по сигналу и освобождение снимков
+	std::mutex tasks_mutex;
+	std::condition_variable tasks_changed;
+	std::string reload_path;
+	bool reload_requested = false;
+	std::vector<std::unique_ptr<const ReadOnlyNetwork>> retired_networks;
+	bool reload_stopping = false;
+	std::thread reload_thread;
+
+	//Принятые соединения ждут свободного потока в pending_clients; active_clients - обслуживаемые,
+	//их деструктор отключает через shutdown. Всё под clients_mutex
+	std::mutex clients_mutex;
+	std::condition_variable clients_changed;
+	std::deque<int> pending_clients;
+	std::unordered_set<int> active_clients;
+	std::atomic<bool> stopping{false};
+	std::vector<std::thread> workers;
+	std::thread signal_thread;
+
+	void ServeClients();
+	void RunReloadTasks();
+	void Publish(std::unique_ptr<const ReadOnlyNetwork> new_network);
+	void Retire(const ReadOnlyNetwork* old_network);
+};
@@ -0,0 +1,18 @@
+#include "snapshot.h"
+#include <iterator>
+
+std::vector<char> ReadWholeStream(std::istream& in){
+	const auto begin = in.tellg();
+	if(begin != std::istream::pos_type(-1) && in.seekg(0, std::ios::end)){
+		const auto end = in.tellg();
+		in.seekg(begin);
+
+		std::vector<char> result(static_cast<size_t>(end - begin));
+		in.read(result.data(), result.size());
+		result.resize(in.gcount());
+		return result;
+	}
+
+	in.clear();
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
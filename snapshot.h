@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+//Примитивы двоичного снимка сети: значения пишутся как есть (little-endian на x86),
+//строки - длиной и байтами. Снимок читается целиком одним чтением и разбирается из памяти.
+
+const uint64_t SNAPSHOT_MAGIC = 0x50414E5355424D42; // "BMBUSNAP"
+const uint32_t SNAPSHOT_VERSION = 4;
+
+class SnapshotWriter {
+public:
+	template <typename T>
+	void Write(const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void WriteString(std::string_view value) {
+		Write(static_cast<uint32_t>(value.size()));
+		buffer.append(value.data(), value.size());
+	}
+
+	void Flush(std::ostream& out) const {
+		out.write(buffer.data(), buffer.size());
+	}
+
+private:
+	std::string buffer;
+};
+
+class SnapshotReader {
+public:
+	explicit SnapshotReader(std::vector<char> data_) : data(std::move(data_)) {}
+
+	template <typename T>
+	T Read() {
+		static_assert(std::is_trivially_copyable_v<T>);
+		Require(sizeof(T));
+		T value{};
+		memcpy(&value, data.data() + position, sizeof(T));
+		position += sizeof(T);
+		return value;
+	}
+
+	std::string_view ReadString() {
+		const uint32_t size = Read<uint32_t>();
+		Require(size);
+		std::string_view result(data.data() + position, size);
+		position += size;
+		return result;
+	}
+
+	bool AtEnd() const {
+		return position == data.size();
+	}
+
+private:
+	std::vector<char> data;
+	size_t position = 0;
+
+	void Require(size_t size) const {
+		if(data.size() - position < size){
+			throw std::invalid_argument("Snapshot is truncated");
+		}
+	}
+};
+
+//Все содержимое потока одним чтением
+std::vector<char> ReadWholeStream(std::istream& in);
@@ -0,0 +1,53 @@
+#include "socketbuffer.h"
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+SocketBuffer::SocketBuffer(int fd): fd(fd), read_buffer(READ_BUFFER_SIZE) {
+	setg(read_buffer.data(), read_buffer.data(), read_buffer.data());
+}
+
+SocketBuffer::~SocketBuffer(){
+	close(fd);
+}
+
+SocketBuffer::int_type SocketBuffer::underflow(){
+	ssize_t read_count = 0;
+	do {
+		read_count = recv(fd, read_buffer.data(), read_buffer.size(), 0);
+	} while(read_count < 0 && errno == EINTR);
+
+	if(read_count <= 0){
+		return traits_type::eof();
+	}
+	setg(read_buffer.data(), read_buffer.data(), read_buffer.data() + read_count);
+	return traits_type::to_int_type(read_buffer[0]);
+}
+
+SocketBuffer::int_type SocketBuffer::overflow(int_type c){
+	if(traits_type::eq_int_type(c, traits_type::eof())){
+		return traits_type::not_eof(c);
+	}
+	const char value = traits_type::to_char_type(c);
+	return WriteAll(&value, 1) ? c : traits_type::eof();
+}
+
+std::streamsize SocketBuffer::xsputn(const char* data, std::streamsize size){
+	return WriteAll(data, size) ? size : 0;
+}
+
+//MSG_NOSIGNAL: закрытый собеседником сокет - ошибка записи, а не SIGPIPE на весь процесс
+bool SocketBuffer::WriteAll(const char* data, size_t size){
+	while(size > 0){
+		const ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+		if(written < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <streambuf>
+#include <vector>
+
+//Буфер потока поверх сокета. Чтение отдает данные, как только они пришли, а не ждет полного
+//куска, поэтому std::getline годится для построчного обмена. Запись уходит в сокет сразу:
+//собирать ответ в большие куски - дело ResponseWriter. Дескриптор закрывается в деструкторе
+class SocketBuffer: public std::streambuf {
+public:
+	explicit SocketBuffer(int fd);
+	~SocketBuffer();
+
+	SocketBuffer(const SocketBuffer&) = delete;
+	SocketBuffer& operator=(const SocketBuffer&) = delete;
+
+protected:
+	int_type underflow() override;
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* data, std::streamsize size) override;
+
+private:
+	static const size_t READ_BUFFER_SIZE = 64 * 1024;
+
+	int fd;
+	std::vector<char> read_buffer;
+
+	bool WriteAll(const char* data, size_t size);
+};
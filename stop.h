@@ -7,4 +7,6 @@ struct Stop{
 	size_t id;
 	std::string name;
 	Point point;
+	bool declared; //Описана в base_requests, а не только упомянута в маршруте или расстояниях
+	GeoPoint geo; //point в радианах с синусами и косинусами, заполняется вместе с declared
 };
@@ -0,0 +1,140 @@
+#include "vertexorder.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+const uint32_t HILBERT_SIDE = 1 << 16;
+
+std::vector<size_t> MakeBreadthFirstOrder(const std::vector<size_t>& offsets, const std::vector<size_t>& neighbours,
+		bool by_degree){
+	const size_t vertex_count = offsets.size() - 1;
+	auto degree = [&offsets](size_t vertex){
+		return offsets[vertex + 1] - offsets[vertex];
+	};
+
+	//Кандидаты в начало очередной компоненты
+	std::vector<size_t> starts(vertex_count);
+	std::iota(starts.begin(), starts.end(), 0);
+	if(by_degree){
+		std::stable_sort(starts.begin(), starts.end(), [&degree](size_t lhs, size_t rhs){
+			return degree(lhs) < degree(rhs);
+		});
+	}
+
+	std::vector<size_t> order;
+	order.reserve(vertex_count);
+	std::vector<bool> visited(vertex_count, false);
+	std::vector<size_t> next;
+	for(const size_t start: starts){
+		if(visited[start]){
+			continue;
+		}
+		visited[start] = true;
+		order.push_back(start);
+		for(size_t head = order.size() - 1; head < order.size(); head++){
+			const size_t vertex = order[head];
+			next.clear();
+			for(size_t i = offsets[vertex]; i < offsets[vertex + 1]; i++){
+				if(!visited[neighbours[i]]){
+					visited[neighbours[i]] = true;
+					next.push_back(neighbours[i]);
+				}
+			}
+			if(by_degree){
+				std::stable_sort(next.begin(), next.end(), [&degree](size_t lhs, size_t rhs){
+					return degree(lhs) < degree(rhs);
+				});
+			}
+			order.insert(order.end(), next.begin(), next.end());
+		}
+	}
+	return order;
+}
+
+}
+
+std::optional<VertexOrder> ParseVertexOrder(std::string_view name){
+	for(const VertexOrder order: {VertexOrder::Bus, VertexOrder::Bfs, VertexOrder::Rcm, VertexOrder::Hilbert}){
+		if(name == GetVertexOrderName(order)){
+			return order;
+		}
+	}
+	return std::nullopt;
+}
+
+const char* GetVertexOrderName(VertexOrder order){
+	switch(order){
+	case VertexOrder::Bus:
+		return "bus";
+	case VertexOrder::Bfs:
+		return "bfs";
+	case VertexOrder::Rcm:
+		return "rcm";
+	case VertexOrder::Hilbert:
+		return "hilbert";
+	}
+	return "";
+}
+
+std::vector<size_t> MakeBfsOrder(const std::vector<size_t>& offsets, const std::vector<size_t>& neighbours){
+	return MakeBreadthFirstOrder(offsets, neighbours, false);
+}
+
+std::vector<size_t> MakeRcmOrder(const std::vector<size_t>& offsets, const std::vector<size_t>& neighbours){
+	std::vector<size_t> order = MakeBreadthFirstOrder(offsets, neighbours, true);
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+//Классический перевод (x, y) -> d с поворотом четвертей
+uint64_t GetHilbertIndex(uint32_t x, uint32_t y){
+	uint64_t result = 0;
+	for(uint32_t side = HILBERT_SIDE / 2; side > 0; side /= 2){
+		const uint32_t rx = (x & side) > 0;
+		const uint32_t ry = (y & side) > 0;
+		result += static_cast<uint64_t>(side) * side * ((3 * rx) ^ ry);
+		if(ry == 0){
+			if(rx == 1){
+				x = HILBERT_SIDE - 1 - x;
+				y = HILBERT_SIDE - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return result;
+}
+
+std::vector<size_t> MakeHilbertOrder(const std::vector<Point>& points){
+	std::vector<size_t> order(points.size());
+	std::iota(order.begin(), order.end(), 0);
+	if(points.empty()){
+		return order;
+	}
+
+	double min_latitude = points[0].latitude, max_latitude = points[0].latitude;
+	double min_longitude = points[0].longitude, max_longitude = points[0].longitude;
+	for(const Point& point: points){
+		min_latitude = std::min(min_latitude, point.latitude);
+		max_latitude = std::max(max_latitude, point.latitude);
+		min_longitude = std::min(min_longitude, point.longitude);
+		max_longitude = std::max(max_longitude, point.longitude);
+	}
+
+	auto scale = [](double value, double min, double max){
+		if(max <= min){
+			return uint32_t(0);
+		}
+		return std::min(HILBERT_SIDE - 1, static_cast<uint32_t>((value - min) / (max - min) * HILBERT_SIDE));
+	};
+	std::vector<uint64_t> indexes(points.size());
+	for(size_t i = 0; i < points.size(); i++){
+		indexes[i] = GetHilbertIndex(scale(points[i].longitude, min_longitude, max_longitude),
+				scale(points[i].latitude, min_latitude, max_latitude));
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&indexes](size_t lhs, size_t rhs){
+		return indexes[lhs] < indexes[rhs];
+	});
+	return order;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "distance.h"
+
+//Нумерация вершин графа перед построением маршрутизатора.
+//Bus - вершины маршрутов подряд в порядке id маршрутов, как их создает FillVertices.
+//Остальные переставляют вершины так, чтобы соседи по графу или по карте имели близкие id
+enum class VertexOrder {
+	Bus,
+	Bfs,
+	Rcm,
+	Hilbert
+};
+
+std::optional<VertexOrder> ParseVertexOrder(std::string_view name);
+const char* GetVertexOrderName(VertexOrder order);
+
+//Во всех функциях результат - order[new_id] = old_id.
+//Граф неориентированный, соседи вершины v - neighbours[offsets[v]..offsets[v + 1])
+
+//Обход в ширину из вершин с наименьшим id в каждой компоненте
+std::vector<size_t> MakeBfsOrder(const std::vector<size_t>& offsets, const std::vector<size_t>& neighbours);
+
+//Обратный Катхилл-Макки: обход в ширину из вершины наименьшей степени,
+//соседи по возрастанию степени, порядок в конце разворачивается
+std::vector<size_t> MakeRcmOrder(const std::vector<size_t>& offsets, const std::vector<size_t>& neighbours);
+
+//По индексу точки на кривой Гильберта 2^16 x 2^16, растянутой на охватывающий прямоугольник.
+//При равных индексах сохраняется прежний порядок
+std::vector<size_t> MakeHilbertOrder(const std::vector<Point>& points);
+
+//Номер клетки (x, y) на кривой Гильберта порядка 16
+uint64_t GetHilbertIndex(uint32_t x, uint32_t y);